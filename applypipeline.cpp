@@ -0,0 +1,250 @@
+#include "applypipeline.h"
+#include "tracer.h"
+#include "xrandrbackend.h"
+#include <QtGui>
+
+ApplyPipeline::ApplyPipeline(QObject *parent)
+:QObject(parent)
+{
+  m_process = new QProcess(this);
+  connect(m_process, &QProcess::finished, this, &ApplyPipeline::onProcessFinished);
+  connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error)
+  {
+    if (error == QProcess::FailedToStart)
+      fail(tr("Could not start %1: %2").arg(m_process->program(), m_process->errorString()));
+  });
+
+  m_screenTimeout.setSingleShot(true);
+  m_screenTimeout.setInterval(kScreenChangeTimeout);
+  connect(&m_screenTimeout, &QTimer::timeout, this, [this]()
+  {
+    qWarning() << "No screen change notification received within" << kScreenChangeTimeout << "ms.";
+    m_screenSettle.stop();
+    m_waitingForScreens = false;
+    completeStage();
+  });
+
+  // RandR reports a reconfiguration as a burst of notifications (one per
+  // output and CRTC); continue once they have stopped arriving.
+  m_screenSettle.setSingleShot(true);
+  m_screenSettle.setInterval(kScreenSettleDelay);
+  connect(&m_screenSettle, &QTimer::timeout, this, [this]()
+  {
+    m_screenTimeout.stop();
+    m_waitingForScreens = false;
+    completeStage();
+  });
+}
+
+QList<ApplyStage> ApplyPipeline::layoutStages(const QList<XRandrMonitorConfig> &xrandrConfigs,
+                                              const QList<XInputDeviceConfig> &xinputConfigs)
+{
+  const XRandrBackend &xrandr = XRandrBackend::instance();
+  const QList<XRandrMonitorConfig> changedConfigs = xrandr.changedConfigs(xrandrConfigs);
+  ApplyStage modesStage;
+  modesStage.name = tr("Modes");
+  const QList<QStringList> modeCommands = xrandr.modeCommands(changedConfigs);
+  for (const QStringList &arguments : modeCommands)
+  {
+    ApplyCommand command;
+    command.program = "xrandr";
+    command.arguments = arguments;
+    // --newmode fails if an earlier apply already created the mode.
+    command.allowFailure = (arguments.constFirst() == "--newmode");
+    modesStage.commands << command;
+  }
+
+  ApplyStage outputsStage;
+  outputsStage.name = tr("Outputs");
+  if (!changedConfigs.isEmpty())
+  {
+    ApplyCommand outputsCommand;
+    outputsCommand.program = "xrandr";
+    outputsCommand.arguments = xrandr.outputArguments(changedConfigs);
+    outputsStage.commands << outputsCommand;
+  }
+  outputsStage.waitForScreenChange = !xrandr.matchesCurrentState(xrandrConfigs);
+
+  ApplyStage touchStage;
+  touchStage.name = tr("Touch");
+  const QString touchScript = XInputBackend::instance().buildScript(xinputConfigs);
+  if (!touchScript.isEmpty())
+  {
+    ApplyCommand touchCommand;
+    touchCommand.program = "/bin/sh";
+    touchCommand.arguments = QStringList() << "-c" << touchScript;
+    touchStage.commands << touchCommand;
+  }
+  return {modesStage, outputsStage, touchStage};
+}
+
+void ApplyPipeline::start(const QList<ApplyStage> &stages)
+{
+  if (m_running)
+    return;
+  m_stages = stages;
+  m_running = true;
+  m_pipelineTimer.start();
+  watchScreens();
+  startStage(0);
+}
+
+void ApplyPipeline::startStage(int index)
+{
+  m_stageIndex = index;
+  if (m_stageIndex >= m_stages.size())
+  {
+    refreshState();
+    return;
+  }
+  const ApplyStage &stage = m_stages.at(m_stageIndex);
+  emit stageStarted(m_stageIndex, m_stages.size(), stage.name);
+  m_stageTimer.start();
+  m_stageTraceStart = Tracer::isEnabled() ? Tracer::instance().nowUs() : 0;
+  m_screenChanged = false;
+  m_commandIndex = -1;
+  runNextCommand();
+}
+
+void ApplyPipeline::runNextCommand()
+{
+  const ApplyStage &stage = m_stages.at(m_stageIndex);
+  ++m_commandIndex;
+  if (m_commandIndex >= stage.commands.size())
+  {
+    finishStage();
+    return;
+  }
+  const ApplyCommand &command = stage.commands.at(m_commandIndex);
+  m_commandTraceStart = Tracer::isEnabled() ? Tracer::instance().nowUs() : 0;
+  m_process->start(command.program, command.arguments);
+}
+
+void ApplyPipeline::finishStage()
+{
+  const ApplyStage &stage = m_stages.at(m_stageIndex);
+  if (stage.waitForScreenChange && !m_screenConnections.isEmpty())
+  {
+    m_waitingForScreens = true;
+    m_screenTimeout.start();
+    if (m_screenChanged)
+      m_screenSettle.start();
+    return;
+  }
+  completeStage();
+}
+
+void ApplyPipeline::completeStage()
+{
+  const ApplyStage &stage = m_stages.at(m_stageIndex);
+  if (Tracer::isEnabled())
+    traceEvent(stage.name, "apply", m_stageTraceStart, {{"commands", stage.commands.size()}});
+  emit stageFinished(m_stageIndex, m_stages.size(), stage.name, m_stageTimer.elapsed());
+  startStage(m_stageIndex + 1);
+}
+
+void ApplyPipeline::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+  if (!m_running)
+    return;
+  if (Tracer::isEnabled())
+  {
+    QString name = m_process->program();
+    if (!m_process->arguments().isEmpty())
+      name += " " + m_process->arguments().constFirst();
+    traceEvent(name, "process", m_commandTraceStart, {{"exitCode", exitCode},
+                                                      {"arguments", m_process->arguments().join(' ')}});
+  }
+
+  if (m_stageIndex >= m_stages.size())
+  {
+    unwatchScreens();
+    m_running = false;
+    if (exitStatus != QProcess::NormalExit || exitCode != 0)
+    {
+      XRandrBackend::instance().invalidate();
+      emit finished(true, tr("Configuration applied in %1 ms, but the new screen configuration could not be read back.")
+                              .arg(m_pipelineTimer.elapsed()));
+      return;
+    }
+    XRandrBackend::instance().parseQueryOutput(m_process->readAllStandardOutput());
+    emit finished(true, tr("Configuration applied in %1 ms.").arg(m_pipelineTimer.elapsed()));
+    return;
+  }
+
+  const ApplyCommand &command = m_stages.at(m_stageIndex).commands.at(m_commandIndex);
+  if ((exitStatus != QProcess::NormalExit || exitCode != 0) && !command.allowFailure)
+  {
+    QString errorText = QString::fromLocal8Bit(m_process->readAllStandardError()).trimmed();
+    fail(tr("%1 failed with exit code %2.\n%3")
+             .arg(command.program + " " + command.arguments.join(' '))
+             .arg(exitCode)
+             .arg(errorText));
+    return;
+  }
+  runNextCommand();
+}
+
+void ApplyPipeline::watchScreens()
+{
+  auto *guiApp = qobject_cast<QGuiApplication *>(QCoreApplication::instance());
+  if (!guiApp)
+    return;
+  auto watchScreen = [this](QScreen *screen)
+  {
+    m_screenConnections << connect(screen, &QScreen::geometryChanged, this, &ApplyPipeline::onScreenChanged);
+  };
+  for (QScreen *screen : QGuiApplication::screens())
+    watchScreen(screen);
+  m_screenConnections << connect(guiApp, &QGuiApplication::screenAdded, this, [this, watchScreen](QScreen *screen)
+  {
+    watchScreen(screen);
+    onScreenChanged();
+  });
+  m_screenConnections << connect(guiApp, &QGuiApplication::screenRemoved, this, &ApplyPipeline::onScreenChanged);
+  m_screenConnections << connect(guiApp, &QGuiApplication::primaryScreenChanged, this, &ApplyPipeline::onScreenChanged);
+}
+
+void ApplyPipeline::unwatchScreens()
+{
+  for (const QMetaObject::Connection &connection : std::as_const(m_screenConnections))
+    disconnect(connection);
+  m_screenConnections.clear();
+  m_screenTimeout.stop();
+  m_screenSettle.stop();
+  m_waitingForScreens = false;
+}
+
+void ApplyPipeline::onScreenChanged()
+{
+  m_screenChanged = true;
+  if (m_waitingForScreens)
+    m_screenSettle.start();
+}
+
+void ApplyPipeline::refreshState()
+{
+  // --current returns the server's state without probing the outputs again.
+  m_commandTraceStart = Tracer::isEnabled() ? Tracer::instance().nowUs() : 0;
+  m_process->start("xrandr", {"--current", "--verbose"});
+}
+
+void ApplyPipeline::fail(const QString &message)
+{
+  if (!m_running)
+    return;
+  unwatchScreens();
+  m_running = false;
+  emit finished(false, message);
+}
+
+void ApplyPipeline::traceEvent(const QString &name, const char *category, qint64 startUs, const QVariantMap &args)
+{
+  TraceEvent event;
+  event.name = name.toUtf8();
+  event.category = category;
+  event.startUs = startUs;
+  event.durationUs = Tracer::instance().nowUs() - startUs;
+  event.args = args;
+  Tracer::instance().addEvent(std::move(event));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QtCore>
+#include "xinputbackend.h"
+#include "xrandrbackend.h"
+
+struct ApplyCommand
+{
+  QString program;
+  QStringList arguments;
+  bool allowFailure = false;
+};
+
+struct ApplyStage
+{
+  QString name;
+  QList<ApplyCommand> commands;
+  // Wait for the X server to report the new screen configuration before
+  // moving on to the next stage.
+  bool waitForScreenChange = false;
+};
+
+// Runs the stages one after the other without blocking the event loop. After
+// the last stage the current RandR state is read back into XRandrBackend;
+// when that fails the backend is invalidated instead of kept stale.
+class ApplyPipeline : public QObject
+{
+  Q_OBJECT
+public:
+  explicit ApplyPipeline(QObject *parent = nullptr);
+
+  bool isRunning() const { return m_running; }
+  void start(const QList<ApplyStage> &stages);
+
+  // Modes, Outputs and Touch stages that apply a layout. Only the outputs
+  // that differ from the current state are reconfigured.
+  static QList<ApplyStage> layoutStages(const QList<XRandrMonitorConfig> &xrandrConfigs,
+                                        const QList<XInputDeviceConfig> &xinputConfigs);
+
+signals:
+  void stageStarted(int index, int count, const QString &name);
+  void stageFinished(int index, int count, const QString &name, qint64 msecs);
+  void finished(bool ok, const QString &message);
+
+private:
+  static constexpr int kScreenChangeTimeout = 5000;
+  static constexpr int kScreenSettleDelay = 150;
+
+  QList<ApplyStage> m_stages;
+  int m_stageIndex = -1;
+  int m_commandIndex = -1;
+  bool m_running = false;
+  bool m_screenChanged = false;
+  bool m_waitingForScreens = false;
+  QProcess *m_process = nullptr;
+  QElapsedTimer m_pipelineTimer;
+  QElapsedTimer m_stageTimer;
+  qint64 m_stageTraceStart = 0;
+  qint64 m_commandTraceStart = 0;
+  QTimer m_screenTimeout;
+  QTimer m_screenSettle;
+  QList<QMetaObject::Connection> m_screenConnections;
+
+  void startStage(int index);
+  void runNextCommand();
+  void finishStage();
+  void completeStage();
+  void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+  void watchScreens();
+  void unwatchScreens();
+  void onScreenChanged();
+  void refreshState();
+  void fail(const QString &message);
+  void traceEvent(const QString &name, const char *category, qint64 startUs, const QVariantMap &args);
+};
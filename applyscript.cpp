@@ -0,0 +1,71 @@
+#include "applyscript.h"
+
+QString buildApplyScript(const QList<XRandrMonitorConfig> &xrandrConfigs,
+                         const QList<XInputDeviceConfig> &xinputConfigs,
+                         const QMap<QString, QString> &edidFingerprints)
+{
+  QString script = "#!/bin/bash\n\n";
+  script += "now_us() {\n";
+  script += "    local t=\"${EPOCHREALTIME:-$(date +%s.%6N)}\"\n";
+  script += "    echo \"${t//[.,]/}\"\n";
+  script += "}\n";
+  script += "seconds() {\n";
+  script += "    printf '%d.%06d' $(($1 / 1000000)) $(($1 % 1000000))\n";
+  script += "}\n";
+  script += ": \"${DPSET_TOUCH_RETRIES:=3}\"\n";
+  // Read once and shared by the EDID check and the state comparison;
+  // --current does not make the server probe the outputs.
+  if (!xrandrConfigs.isEmpty() || !edidFingerprints.isEmpty())
+    script += "randr_verbose=$(xrandr --current --verbose 2>/dev/null)\n";
+  script += XRandrBackend::buildEdidCheck(edidFingerprints);
+  script += "run_start=$(now_us)\n\n";
+
+  script += XRandrBackend::instance().buildScript(xrandrConfigs);
+  script += "\nrandr_status=$?\n";
+  script += "randr_end=$(now_us)\n\n";
+
+  script += XInputBackend::instance().buildScript(xinputConfigs);
+  script += "run_end=$(now_us)\n\n";
+
+  script += "outputs_reconfigured=0\n";
+  script += "for arg in \"${xrandr_args[@]}\"; do\n";
+  script += "    [ \"$arg\" = \"--output\" ] && outputs_reconfigured=$((outputs_reconfigured + 1))\n";
+  script += "done\n";
+  script += "modesets=$(( outputs_reconfigured > 0 ? 1 : 0 ))\n";
+  script += "metrics_file=\"${DPSET_METRICS_FILE:-${XDG_RUNTIME_DIR:-/tmp}/dpset.prom}\"\n";
+  script += "{\n";
+  script += "    echo \"# HELP dpset_phase_duration_seconds Duration of each phase of the last layout apply.\"\n";
+  script += "    echo \"# TYPE dpset_phase_duration_seconds gauge\"\n";
+  script += "    echo \"dpset_phase_duration_seconds{phase=\\\"randr\\\"} $(seconds $((randr_end - run_start)))\"\n";
+  script += "    echo \"dpset_phase_duration_seconds{phase=\\\"touch\\\"} $(seconds $((run_end - randr_end)))\"\n";
+  script += "    echo \"dpset_phase_duration_seconds{phase=\\\"total\\\"} $(seconds $((run_end - run_start)))\"\n";
+  script += "    echo \"# HELP dpset_modesets Number of RandR reconfigurations performed by the last apply.\"\n";
+  script += "    echo \"# TYPE dpset_modesets gauge\"\n";
+  script += "    echo \"dpset_modesets $modesets\"\n";
+  script += "    echo \"# HELP dpset_outputs_reconfigured Number of outputs that differed from the target layout.\"\n";
+  script += "    echo \"# TYPE dpset_outputs_reconfigured gauge\"\n";
+  script += "    echo \"dpset_outputs_reconfigured $outputs_reconfigured\"\n";
+  script += "    echo \"# HELP dpset_randr_success Whether the RandR reconfiguration succeeded.\"\n";
+  script += "    echo \"# TYPE dpset_randr_success gauge\"\n";
+  script += "    echo \"dpset_randr_success $(( randr_status == 0 ? 1 : 0 ))\"\n";
+  script += "    echo \"# HELP dpset_touch_devices_not_found Number of mapped touch devices that were not found.\"\n";
+  script += "    echo \"# TYPE dpset_touch_devices_not_found gauge\"\n";
+  script += "    echo \"dpset_touch_devices_not_found ${touch_not_found:-0}\"\n";
+  script += "    echo \"# HELP dpset_touch_matrices_set Number of touch devices whose matrix was changed.\"\n";
+  script += "    echo \"# TYPE dpset_touch_matrices_set gauge\"\n";
+  script += "    echo \"dpset_touch_matrices_set ${touch_matrices_set:-0}\"\n";
+  script += "    echo \"# HELP dpset_touch_retries Number of extra touch device lookups.\"\n";
+  script += "    echo \"# TYPE dpset_touch_retries gauge\"\n";
+  script += "    echo \"dpset_touch_retries ${touch_retries:-0}\"\n";
+  script += "    echo \"# HELP dpset_last_run_timestamp_seconds Time of the last apply.\"\n";
+  script += "    echo \"# TYPE dpset_last_run_timestamp_seconds gauge\"\n";
+  script += "    echo \"dpset_last_run_timestamp_seconds $((run_end / 1000000))\"\n";
+  // Write to a temporary file first so the collector never reads a partial file.
+  script += "} > \"$metrics_file.$$\" 2>/dev/null && mv -f \"$metrics_file.$$\" \"$metrics_file\"\n";
+  script += "if command -v logger > /dev/null; then\n";
+  script += "    logger -t dpset \"apply: total=$(seconds $((run_end - run_start)))s modesets=$modesets"
+            " outputs_reconfigured=$outputs_reconfigured randr_status=$randr_status"
+            " touch_not_found=${touch_not_found:-0} touch_retries=${touch_retries:-0}\"\n";
+  script += "fi\n";
+  return script;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QtCore>
+#include "xinputbackend.h"
+#include "xrandrbackend.h"
+
+// Complete bash script that applies the layout and the touch mappings, e.g.
+// at login. Each run writes its phase durations and counters as Prometheus
+// text to $DPSET_METRICS_FILE (default $XDG_RUNTIME_DIR/dpset.prom) for the
+// node exporter's textfile collector, and a summary line to the journal.
+// With edidFingerprints (output -> fingerprint) the script first checks that
+// it runs on the monitors it was made for.
+QString buildApplyScript(const QList<XRandrMonitorConfig> &xrandrConfigs,
+                         const QList<XInputDeviceConfig> &xinputConfigs,
+                         const QMap<QString, QString> &edidFingerprints = {});
@@ -0,0 +1,227 @@
+#include "batchgenerator.h"
+#include "applyscript.h"
+#include "layoutmodel.h"
+#include "layoutvalidation.h"
+#include "tracer.h"
+#include "xinputbackend.h"
+#include "xrandrbackend.h"
+
+namespace
+{
+  QSize sizeFromString(const QString &text)
+  {
+    const QStringList parts = text.split('x');
+    if (parts.size() != 2)
+      return QSize();
+    return QSize(parts.at(0).toInt(), parts.at(1).toInt());
+  }
+
+  bool writeFile(const QString &path, const QString &text, QStringList &problems)
+  {
+    // Written to a temporary file and renamed, so a console never gets half a file.
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+      problems << QString("Cannot open %1 for writing.").arg(path);
+      return false;
+    }
+    file.write(text.toUtf8());
+    if (!file.commit())
+    {
+      problems << QString("Cannot write %1.").arg(path);
+      return false;
+    }
+    return true;
+  }
+
+  // Places the outputs side by side in manifest order; clones stay with their sources.
+  bool arrange(LayoutModel &model, const QString &direction)
+  {
+    if (direction != "row" && direction != "column")
+      return false;
+    QList<int> indices;
+    QList<QPoint> positions;
+    QPoint next;
+    for (int i = 0; i < model.count(); ++i)
+    {
+      const LayoutOutput &out = model.output(i);
+      if (out.isClone())
+        continue;
+      indices << i;
+      positions << next;
+      if (direction == "row")
+        next.rx() += out.size().width();
+      else
+        next.ry() += out.size().height();
+    }
+    model.setPositions(indices, positions);
+    return true;
+  }
+}
+
+bool BatchGenerator::loadManifest(const QString &fileName)
+{
+  m_consoles.clear();
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    m_errorString = QString("Cannot open %1.").arg(fileName);
+    return false;
+  }
+  QJsonParseError error;
+  const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+  if (error.error != QJsonParseError::NoError)
+  {
+    m_errorString = QString("%1 at offset %2.").arg(error.errorString()).arg(error.offset);
+    return false;
+  }
+  const QJsonArray consoles = doc.object().value("consoles").toArray();
+  if (consoles.isEmpty())
+  {
+    m_errorString = "The manifest lists no consoles.";
+    return false;
+  }
+  // The name becomes the directory of the console.
+  QSet<QString> names;
+  m_consoles.reserve(consoles.size());
+  for (const QJsonValue &value : consoles)
+  {
+    const QJsonObject console = value.toObject();
+    const QString name = console.value("name").toString();
+    if (name.isEmpty() || name == "." || name == ".." || name.contains('/'))
+    {
+      m_errorString = QString("Console %1 has no valid name.").arg(m_consoles.size() + 1);
+      m_consoles.clear();
+      return false;
+    }
+    if (names.contains(name))
+    {
+      m_errorString = QString("Console %1 is listed twice.").arg(name);
+      m_consoles.clear();
+      return false;
+    }
+    names.insert(name);
+    m_consoles << console;
+  }
+  m_errorString.clear();
+  return true;
+}
+
+BatchGenerator::Result BatchGenerator::run(const QString &outputDir, int jobs) const
+{
+  TraceScope scope("BatchGenerator::run");
+  scope.setArg("consoles", m_consoles.size());
+  QElapsedTimer timer;
+  timer.start();
+  // Created up front, so the workers only call their const builders.
+  XRandrBackend::instance();
+  XInputBackend::instance();
+
+  const QDir dir(outputDir);
+  QMutex mutex;
+  Result result;
+  result.consoles = m_consoles.size();
+  QThreadPool pool;
+  pool.setMaxThreadCount(qMax(1, jobs));
+  for (const QJsonObject &console : m_consoles)
+  {
+    pool.start([&dir, &mutex, &result, console]()
+    {
+      const QStringList problems = generate(console, dir);
+      if (problems.isEmpty())
+        return;
+      QMutexLocker locker(&mutex);
+      ++result.failed;
+      for (const QString &problem : problems)
+        qWarning().noquote() << console.value("name").toString() + ':' << problem;
+    });
+  }
+  pool.waitForDone();
+  result.elapsedMs = timer.elapsed();
+  return result;
+}
+
+QStringList BatchGenerator::generate(const QJsonObject &console, const QDir &outputDir)
+{
+  TraceScope scope("BatchGenerator::generate");
+  const QString name = console.value("name").toString();
+  scope.setArg("console", name);
+
+  LayoutModel model;
+  if (!model.fromJson(console))
+    return {"Every output needs a name and a mode."};
+  const QString direction = console.value("arrange").toString();
+  if (!direction.isEmpty() && !arrange(model, direction))
+    return {QString("Unknown arrangement %1; use row or column.").arg(direction)};
+
+  // The RandR state the manifest knows of stands in for the X server.
+  QHash<QString, XRandrMonitorInfo> monitors;
+  QMap<QString, QString> fingerprints;
+  LayoutConstraints constraints;
+  constraints.maximumScreenSize = sizeFromString(console.value("maxScreenSize").toString());
+  QSet<int> crtcs;
+  QStringList problems;
+  static const QRegularExpression reFingerprint("^[0-9a-f]{64}$");
+  for (const QJsonValue &value : console.value("outputs").toArray())
+  {
+    const QJsonObject obj = value.toObject();
+    const QString output = obj.value("name").toString();
+    XRandrMonitorInfo info;
+    info.connected = true;
+    info.crtc = obj.value("crtc").toInt(-1);
+    for (const QJsonValue &crtc : obj.value("crtcs").toArray())
+    {
+      info.crtcs << crtc.toInt();
+      crtcs.insert(crtc.toInt());
+    }
+    for (const QJsonValue &clone : obj.value("clones").toArray())
+      info.clones << clone.toString();
+    monitors.insert(output, info);
+    OutputConstraints oc;
+    oc.crtcs = info.crtcs;
+    oc.clones = info.clones;
+    constraints.outputs.insert(output, oc);
+
+    const QString edid = obj.value("edid").toString().toLower();
+    if (edid.isEmpty())
+      continue;
+    if (reFingerprint.match(edid).hasMatch())
+      fingerprints.insert(output, edid);
+    else
+      problems << QString("%1: the EDID fingerprint is not a SHA-256 hash.").arg(output);
+  }
+  constraints.crtcs = crtcs.values();
+  std::sort(constraints.crtcs.begin(), constraints.crtcs.end());
+
+  const QList<LayoutIssue> issues = validateLayout(model.outputs(), constraints);
+  for (const LayoutIssue &issue : issues)
+    problems << QString("%1: %2").arg(model.output(issue.output).name, issue.message);
+
+  const QList<XRandrMonitorConfig> xrandrConfigs = model.xrandrConfigs(monitors);
+  const QList<XInputDeviceConfig> xinputConfigs = model.xinputConfigs();
+  const XRandrBackend &xrandr = XRandrBackend::instance();
+  const QString xorgConfig = xrandr.buildXorgConfig(xrandrConfigs);
+  problems << xrandr.validateXorgConfig(xorgConfig, xrandrConfigs);
+  if (!problems.isEmpty())
+    return problems;
+
+  const QString dir = outputDir.filePath(name);
+  if (!QDir().mkpath(dir))
+    return {QString("Cannot create %1.").arg(dir)};
+  const QString scriptPath = dir + "/monitor_setup.sh";
+  if (writeFile(scriptPath, buildApplyScript(xrandrConfigs, xinputConfigs, fingerprints), problems))
+    QFile::setPermissions(scriptPath, QFile::permissions(scriptPath) | QFile::ExeOwner | QFile::ExeGroup | QFile::ExeOther);
+  writeFile(dir + "/layout.json", QString::fromUtf8(QJsonDocument(model.toJson()).toJson()), problems);
+  writeFile(dir + "/90-dpset-monitors.conf", xorgConfig, problems);
+
+  bool hasTouch = false;
+  for (const LayoutOutput &out : model.outputs())
+    hasTouch = hasTouch || out.hasTouchDevice();
+  if (hasTouch)
+  {
+    XInputBackend &xinput = XInputBackend::instance();
+    writeFile(dir + "/70-dpset-touch.rules", xinput.buildUdevRules(xinputConfigs), problems);
+    writeFile(dir + "/90-dpset-touch.conf", xinput.buildEvdevConfig(xinputConfigs), problems);
+  }
+  return problems;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QtCore>
+
+// Makes the files of many consoles from a hardware manifest, without an X
+// server: the apply script, the layout, the Xorg configuration and the touch
+// rules, one directory per console. A console in the manifest is a saved
+// layout (see LayoutModel::toJson()) with a "name", optionally "arrange"
+// ("row" or "column", in manifest order) and "maxScreenSize". Its outputs may
+// add the "edid" fingerprint the script checks for, see
+// XRandrBackend::edidFingerprint(), and the "crtc", "crtcs" and "clones"
+// RandR reports, which decide whether the GPU can set the layout. A manifest
+// lists no modes, so no mode object is known to be shared and clones are
+// driven with --same-as or --scale-from, see XRandrBackend::planClones().
+class BatchGenerator
+{
+public:
+  struct Result
+  {
+    int consoles = 0;
+    int failed = 0;
+    qint64 elapsedMs = 0;
+  };
+
+  // Reads the manifest; errorString() tells why it was rejected.
+  bool loadManifest(const QString &fileName);
+  QString errorString() const { return m_errorString; }
+  int consoleCount() const { return m_consoles.size(); }
+
+  // Writes all consoles below outputDir on up to jobs threads and reports
+  // the problems of each console that could not be written.
+  Result run(const QString &outputDir, int jobs) const;
+
+  // Writes the files of one console; returns its problems, empty on success.
+  static QStringList generate(const QJsonObject &console, const QDir &outputDir);
+
+private:
+  QList<QJsonObject> m_consoles;
+  QString m_errorString;
+};
@@ -0,0 +1,171 @@
+#include "layoutgeometry.h"
+#include <map>
+#include <numeric>
+
+namespace
+{
+  // Piecewise constant function over one axis. Every key starts a segment that
+  // runs up to the next key; its value is the furthest edge reached there by
+  // the rectangles placed so far.
+  class Skyline
+  {
+  public:
+    Skyline()
+    {
+      m_steps.emplace(std::numeric_limits<int>::min(), 0);
+    }
+
+    int maxOver(int from, int to) const
+    {
+      auto it = std::prev(m_steps.upper_bound(from));
+      int result = it->second;
+      for (++it; it != m_steps.end() && it->first < to; ++it)
+        result = std::max(result, it->second);
+      return result;
+    }
+
+    void raise(int from, int to, int value)
+    {
+      int tail = std::prev(m_steps.upper_bound(to))->second;
+      m_steps.erase(m_steps.lower_bound(from), m_steps.lower_bound(to));
+      m_steps[from] = value;
+      m_steps.emplace(to, tail);
+    }
+
+  private:
+    std::map<int, int> m_steps;
+  };
+
+  // Slides all rectangles towards 0 along x, or along y when vertical is set.
+  // With ignoreSlightOverlap, rectangles whose extents across the sweep axis
+  // overlap by less than a quarter of their size do not block each other;
+  // those belong to the neighbouring row or column and are separated by the
+  // other pass.
+  void compactAxis(QList<QRect> &rects, bool vertical, bool ignoreSlightOverlap)
+  {
+    auto start = [vertical](const QRect &r) { return vertical ? r.y() : r.x(); };
+    auto crossStart = [vertical](const QRect &r) { return vertical ? r.x() : r.y(); };
+
+    QList<int> order(rects.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+    {
+      const QRect &ra = rects.at(a);
+      const QRect &rb = rects.at(b);
+      if (start(ra) != start(rb))
+        return start(ra) < start(rb);
+      return crossStart(ra) < crossStart(rb);
+    });
+
+    Skyline skyline;
+    for (int index : std::as_const(order))
+    {
+      QRect &r = rects[index];
+      int length = vertical ? r.height() : r.width();
+      int crossLength = std::max(1, vertical ? r.width() : r.height());
+      int from = crossStart(r);
+      int to = from + crossLength;
+      if (ignoreSlightOverlap && crossLength >= 4)
+      {
+        from += crossLength / 4;
+        to -= crossLength / 4;
+      }
+      int placed = skyline.maxOver(from, to);
+      skyline.raise(from, to, placed + length);
+      if (vertical)
+        r.moveTop(placed);
+      else
+        r.moveLeft(placed);
+    }
+  }
+}
+
+QList<QPoint> compactLayout(const QList<QRect> &rects)
+{
+  QList<QRect> placed = rects;
+  compactAxis(placed, false, true);
+  // The vertical pass honours every overlap, which guarantees that no two
+  // outputs overlap afterwards.
+  compactAxis(placed, true, false);
+
+  QList<QPoint> result;
+  result.reserve(placed.size());
+  for (const QRect &r : std::as_const(placed))
+    result.append(r.topLeft());
+  return result;
+}
+
+QPoint snapOffset(const QRect &rect, const QList<QRect> &others, int distance)
+{
+  // QRect::right() is inclusive; compare exclusive edges so touching rects line up.
+  const int myX[2] = {rect.x(), rect.x() + rect.width()};
+  const int myY[2] = {rect.y(), rect.y() + rect.height()};
+  int bestDx = distance + 1;
+  int bestDy = distance + 1;
+  for (const QRect &other : others)
+  {
+    const int otherX[2] = {other.x(), other.x() + other.width()};
+    const int otherY[2] = {other.y(), other.y() + other.height()};
+    for (int mine = 0; mine < 2; ++mine)
+    {
+      for (int theirs = 0; theirs < 2; ++theirs)
+      {
+        const int dx = otherX[theirs] - myX[mine];
+        if (qAbs(dx) < qAbs(bestDx))
+          bestDx = dx;
+        const int dy = otherY[theirs] - myY[mine];
+        if (qAbs(dy) < qAbs(bestDy))
+          bestDy = dy;
+      }
+    }
+  }
+  return QPoint(qAbs(bestDx) <= distance ? bestDx : 0,
+                qAbs(bestDy) <= distance ? bestDy : 0);
+}
+
+QList<QPair<int, int>> findOverlaps(const QList<QRect> &rects)
+{
+  QList<int> order;
+  order.reserve(rects.size());
+  for (int i = 0; i < rects.size(); ++i)
+  {
+    if (!rects.at(i).isEmpty())
+      order.append(i);
+  }
+  std::sort(order.begin(), order.end(), [&rects](int a, int b)
+  {
+    return rects.at(a).x() < rects.at(b).x();
+  });
+
+  QList<QPair<int, int>> overlaps;
+  QList<int> active;
+  for (int index : std::as_const(order))
+  {
+    const QRect &r = rects.at(index);
+    active.removeIf([&](int other)
+    {
+      const QRect &o = rects.at(other);
+      return o.x() + o.width() <= r.x();
+    });
+    for (int other : std::as_const(active))
+    {
+      const QRect &o = rects.at(other);
+      if (o.y() < r.y() + r.height() && r.y() < o.y() + o.height())
+        overlaps.append(qMakePair(qMin(index, other), qMax(index, other)));
+    }
+    active.append(index);
+  }
+  return overlaps;
+}
+
+QSize framebufferSize(const QList<QRect> &rects)
+{
+  int width = 0;
+  int height = 0;
+  for (const QRect &r : rects)
+  {
+    width = std::max(width, r.x() + r.width());
+    height = std::max(height, r.y() + r.height());
+  }
+  return QSize(width, height);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QtCore>
+
+// Bytes per pixel of the X screen's scanout buffer (depth 24 is stored as 32 bpp).
+constexpr int kFramebufferBytesPerPixel = 4;
+
+// Moves every output left and then up until it touches the origin or another
+// output. Gaps disappear and overlapping outputs are pushed apart, while the
+// left/right and above/below order of the outputs is kept. Runs a sweep over a
+// skyline of the already placed outputs, so it is O(n log n) in the number of
+// outputs. Returns the new top-left corner of each rectangle, in input order.
+QList<QPoint> compactLayout(const QList<QRect> &rects);
+
+// Offset that moves rect so that its nearest left/right and top/bottom edges
+// line up with edges of the other rectangles, for edges at most distance
+// apart. Each axis snaps independently; a zero component means no snap.
+QPoint snapOffset(const QRect &rect, const QList<QRect> &others, int distance);
+
+// Returns the index pairs (i < j) of all rectangles that overlap.
+QList<QPair<int, int>> findOverlaps(const QList<QRect> &rects);
+
+// Size of the X screen needed to contain all outputs; the screen always starts at 0,0.
+QSize framebufferSize(const QList<QRect> &rects);
+
+inline qint64 framebufferBytes(const QSize &size)
+{
+  return qint64(size.width()) * qint64(size.height()) * kFramebufferBytesPerPixel;
+}
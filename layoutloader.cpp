@@ -0,0 +1,149 @@
+#include "layoutloader.h"
+#include "tracer.h"
+#include "xinputbackend.h"
+#include "xrandrbackend.h"
+
+namespace
+{
+  // An output block starts with e.g. "HDMI-1 connected primary 1920x1080+0+0 ...".
+  bool isOutputHeader(QByteArrayView line)
+  {
+    if (line.isEmpty() || line.front() == ' ' || line.front() == '\t')
+      return false;
+    const qsizetype space = line.indexOf(' ');
+    if (space < 0)
+      return false;
+    const QByteArrayView status = line.sliced(space + 1);
+    return status.startsWith("connected") || status.startsWith("disconnected");
+  }
+}
+
+LayoutLoader::LayoutLoader(LayoutModel *model, QObject *parent)
+:QObject(parent),
+m_model(model)
+{
+  m_process = new QProcess(this);
+  connect(m_process, &QProcess::readyReadStandardOutput, this, &LayoutLoader::onReadyRead);
+  connect(m_process, &QProcess::finished, this, &LayoutLoader::onProcessFinished);
+  connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error)
+  {
+    if (error == QProcess::FailedToStart)
+      onProcessFinished(-1, QProcess::CrashExit);
+  });
+  m_timeout.setSingleShot(true);
+  m_timeout.setInterval(kQueryTimeout);
+  connect(&m_timeout, &QTimer::timeout, m_process, &QProcess::kill);
+}
+
+void LayoutLoader::start()
+{
+  if (m_running)
+    return;
+  m_running = true;
+  m_output.clear();
+  m_blockStart = -1;
+  m_scanned = 0;
+  m_model->setOutputs({});
+  m_touchMappings = LayoutModel::storedTouchMappings();
+  if (Tracer::isEnabled())
+    m_traceStart = Tracer::instance().nowUs();
+  // --verbose adds the output properties to the regular query output.
+  m_process->start("xrandr", {"--query", "--verbose"});
+  m_timeout.start();
+}
+
+void LayoutLoader::onReadyRead()
+{
+  m_output += m_process->readAllStandardOutput();
+  qsizetype end;
+  while ((end = m_output.indexOf('\n', m_scanned)) >= 0)
+  {
+    if (isOutputHeader(QByteArrayView(m_output).sliced(m_scanned, end - m_scanned)))
+    {
+      // The next header completes the previous block.
+      if (m_blockStart >= 0)
+        parseBlock(m_scanned);
+      m_blockStart = m_scanned;
+    }
+    m_scanned = end + 1;
+  }
+}
+
+void LayoutLoader::parseBlock(qsizetype end)
+{
+  const QHash<QString, XRandrMonitorInfo> monitors =
+      XRandrBackend::parseMonitors(m_output.mid(m_blockStart, end - m_blockStart));
+  for (auto it = monitors.constBegin(); it != monitors.constEnd(); ++it)
+  {
+    if (it->connected)
+      m_model->appendOutput(it.key(), it.value());
+  }
+}
+
+void LayoutLoader::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+  if (!m_running)
+    return;
+  m_timeout.stop();
+  onReadyRead();
+  if (m_blockStart >= 0)
+  {
+    parseBlock(m_output.size());
+    m_blockStart = -1;
+  }
+
+  const bool ok = exitStatus == QProcess::NormalExit && exitCode == 0;
+  if (ok)
+  {
+    XRandrBackend::instance().parseQueryOutput(m_output);
+    // The CRTC assignment is only known once the whole query is parsed.
+    m_model->detectClones();
+  }
+  else
+    qWarning() << "xrandr query timed out or failed.";
+
+  if (Tracer::isEnabled())
+  {
+    TraceEvent event;
+    event.name = "LayoutLoader xrandr --query --verbose";
+    event.category = "process";
+    event.startUs = m_traceStart;
+    event.durationUs = Tracer::instance().nowUs() - m_traceStart;
+    event.args.insert("outputs", m_model->count());
+    event.args.insert("exitCode", exitCode);
+    Tracer::instance().addEvent(std::move(event));
+  }
+  if (!ok)
+  {
+    m_running = false;
+    // A killed process reports the signal, not an exit code.
+    emit failed(exitStatus == QProcess::NormalExit
+                ? tr("xrandr failed with exit code %1.").arg(exitCode)
+                : tr("xrandr did not answer within %1 seconds or could not be started.").arg(kQueryTimeout / 1000));
+    return;
+  }
+  finishOutputs();
+}
+
+void LayoutLoader::finishOutputs()
+{
+  emit outputsLoaded();
+  if (m_touchMappings.isEmpty() || m_model->count() == 0)
+  {
+    m_running = false;
+    emit finished();
+    return;
+  }
+  // Only probe the input devices when a mapping has to be verified.
+  XInputBackend &xinput = XInputBackend::instance();
+  connect(&xinput, &XInputBackend::devicesLoaded, this, &LayoutLoader::onDevicesLoaded,
+          Qt::SingleShotConnection);
+  xinput.loadInBackground();
+}
+
+void LayoutLoader::onDevicesLoaded()
+{
+  m_model->attachTouchDevices(m_touchMappings, XInputBackend::instance().devices());
+  m_running = false;
+  emit finished();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QtCore>
+#include "layoutmodel.h"
+
+// Fills a LayoutModel from the X server without blocking the event loop. The
+// xrandr output is parsed while it streams in and every connected output is
+// appended to the model as soon as its block is complete. The stored touch
+// mappings are verified afterwards, with the input devices probed on a
+// worker thread.
+class LayoutLoader : public QObject
+{
+  Q_OBJECT
+public:
+  explicit LayoutLoader(LayoutModel *model, QObject *parent = nullptr);
+
+  void start();
+  bool isRunning() const { return m_running; }
+
+signals:
+  // All outputs are in the model and XRandrBackend holds the queried state.
+  void outputsLoaded();
+  // The touch devices are attached; loading is complete.
+  void finished();
+  // xrandr failed or timed out; the backend state was not updated and
+  // neither outputsLoaded() nor finished() follows.
+  void failed(const QString &message);
+
+private:
+  static constexpr int kQueryTimeout = 10000;
+
+  LayoutModel *m_model;
+  QProcess *m_process = nullptr;
+  QTimer m_timeout;
+  QByteArray m_output;
+  // Offset in m_output of the output block that is not yet complete.
+  qsizetype m_blockStart = -1;
+  qsizetype m_scanned = 0;
+  QHash<QString, XInputDevice> m_touchMappings;
+  qint64 m_traceStart = 0;
+  bool m_running = false;
+
+  void onReadyRead();
+  void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+  void parseBlock(qsizetype end);
+  void finishOutputs();
+  void onDevicesLoaded();
+};
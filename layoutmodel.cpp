@@ -0,0 +1,803 @@
+#include "layoutmodel.h"
+#include "tracer.h"
+
+namespace
+{
+  const char *kSettingsOrganization = "Orgelmakerij Noorlander B.V.";
+  const char *kSettingsApplication = "dpset";
+
+  QString sizeToString(const QSize &size)
+  {
+    return QString("%1x%2").arg(size.width()).arg(size.height());
+  }
+
+  // Orientations in the order a clockwise turn of the panel steps through:
+  // its picture then has to turn counterclockwise.
+  const Orientation kClockwiseTurns[4] = {
+      Orientation::Normal, Orientation::Left, Orientation::Inverted, Orientation::Right
+  };
+
+  Orientation turnedClockwise(Orientation orientation, int turns)
+  {
+    int index = 0;
+    while (kClockwiseTurns[index] != orientation)
+      ++index;
+    return kClockwiseTurns[(index + turns) % 4];
+  }
+
+  QSize sizeFromString(const QString &text)
+  {
+    const QStringList parts = text.split('x');
+    if (parts.size() != 2)
+      return QSize();
+    return QSize(parts.at(0).toInt(), parts.at(1).toInt());
+  }
+}
+
+QSize LayoutOutput::size() const
+{
+  if (orientation == Orientation::Left || orientation == Orientation::Right)
+    return mode.transposed();
+  return mode;
+}
+
+QRect LayoutOutput::tileRect(const LayoutTile &tile) const
+{
+  // The matrix is the one xrandr prints, for column vectors.
+  const QTransform t = XRandrBackend::rotationTransform(mode, orientation, reflection);
+  auto map = [&t](const QPoint &p)
+  {
+    return QPointF(t.m11() * p.x() + t.m12() * p.y() + t.m13(),
+                   t.m21() * p.x() + t.m22() * p.y() + t.m23());
+  };
+  const QRect &r = tile.rect;
+  return QRectF(map(r.topLeft()), map(r.topLeft() + QPoint(r.width(), r.height()))).normalized().toRect();
+}
+
+LayoutModel::LayoutModel(QObject *parent)
+:QObject(parent)
+{
+}
+
+void LayoutModel::setOutputs(const QList<LayoutOutput> &outputs)
+{
+  m_outputs = outputs;
+  rebuildIndex();
+  syncClones();
+  emit layoutChanged();
+}
+
+void LayoutModel::setPosition(int index, const QPoint &position)
+{
+  LayoutOutput &out = m_outputs[index];
+  if (out.position == position || out.isClone())
+    return;
+  out.position = position;
+  emit outputChanged(index);
+  const QList<int> clones = syncClones();
+  for (int clone : clones)
+    emit outputChanged(clone);
+}
+
+void LayoutModel::setPositions(const QList<QPoint> &positions)
+{
+  const int n = qMin(positions.size(), m_outputs.size());
+  for (int i = 0; i < n; ++i)
+    m_outputs[i].position = positions.at(i);
+  syncClones();
+  emit layoutChanged();
+}
+
+void LayoutModel::setPositions(const QList<int> &indices, const QList<QPoint> &positions)
+{
+  const int n = qMin(indices.size(), positions.size());
+  for (int i = 0; i < n; ++i)
+    m_outputs[indices.at(i)].position = positions.at(i);
+  syncClones();
+  emit layoutChanged();
+}
+
+void LayoutModel::alignOutputs(const QList<int> &indices, Qt::Alignment edge)
+{
+  const QRect group = bounds(indices);
+  for (int index : indices)
+  {
+    LayoutOutput &out = m_outputs[index];
+    const QSize size = out.size();
+    if (edge & Qt::AlignLeft)
+      out.position.setX(group.x());
+    else if (edge & Qt::AlignRight)
+      out.position.setX(group.x() + group.width() - size.width());
+    if (edge & Qt::AlignTop)
+      out.position.setY(group.y());
+    else if (edge & Qt::AlignBottom)
+      out.position.setY(group.y() + group.height() - size.height());
+  }
+  syncClones();
+  emit layoutChanged();
+}
+
+void LayoutModel::arrangeOutputs(const QList<int> &indices, Qt::Orientation direction)
+{
+  if (indices.isEmpty())
+    return;
+  const QRect group = bounds(indices);
+  QList<int> order = indices;
+  std::sort(order.begin(), order.end(), [this, direction](int a, int b)
+  {
+    const QPoint pa = m_outputs.at(a).position;
+    const QPoint pb = m_outputs.at(b).position;
+    if (direction == Qt::Horizontal)
+      return pa.x() != pb.x() ? pa.x() < pb.x() : pa.y() < pb.y();
+    return pa.y() != pb.y() ? pa.y() < pb.y() : pa.x() < pb.x();
+  });
+  QPoint next = group.topLeft();
+  for (int index : std::as_const(order))
+  {
+    LayoutOutput &out = m_outputs[index];
+    out.position = next;
+    if (direction == Qt::Horizontal)
+      next.rx() += out.size().width();
+    else
+      next.ry() += out.size().height();
+  }
+  syncClones();
+  emit layoutChanged();
+}
+
+void LayoutModel::rotateOutputs(const QList<int> &indices, int clockwiseTurns)
+{
+  const int turns = ((clockwiseTurns % 4) + 4) % 4;
+  if (turns == 0 || indices.isEmpty())
+    return;
+  const QRect before = bounds(indices);
+  const QPointF center = QRectF(before).center();
+  for (int index : indices)
+  {
+    LayoutOutput &out = m_outputs[index];
+    QPointF offset = QRectF(out.rect()).center() - center;
+    for (int i = 0; i < turns; ++i)
+      offset = QPointF(-offset.y(), offset.x());
+    out.orientation = turnedClockwise(out.orientation, turns);
+    const QSize size = out.size();
+    out.position = QPointF(center + offset - QPointF(size.width() / 2.0, size.height() / 2.0)).toPoint();
+  }
+  // Keep the group anchored at its previous top-left corner.
+  const QPoint shift = before.topLeft() - bounds(indices).topLeft();
+  for (int index : indices)
+    m_outputs[index].position += shift;
+  syncClones();
+  emit layoutChanged();
+}
+
+void LayoutModel::setMode(int index, const QSize &mode)
+{
+  // The tiles of a tiled display always run at their native timing.
+  if (m_outputs.at(index).isTiled())
+    return;
+  m_outputs[index].mode = mode;
+  emit outputChanged(index);
+  // The area of the clones is that of their source.
+  for (int i = 0; i < m_outputs.size(); ++i)
+  {
+    if (m_outputs.at(i).cloneOf == m_outputs.at(index).name)
+      emit outputChanged(i);
+  }
+}
+
+void LayoutModel::setOrientation(int index, Orientation orientation)
+{
+  if (m_outputs.at(index).isClone())
+    return;
+  m_outputs[index].orientation = orientation;
+  emit outputChanged(index);
+  const QList<int> clones = syncClones();
+  for (int clone : clones)
+    emit outputChanged(clone);
+}
+
+void LayoutModel::setReflection(int index, Reflection reflection)
+{
+  if (m_outputs.at(index).isClone())
+    return;
+  m_outputs[index].reflection = reflection;
+  emit outputChanged(index);
+  const QList<int> clones = syncClones();
+  for (int clone : clones)
+    emit outputChanged(clone);
+}
+
+void LayoutModel::setPrimary(int index, bool primary)
+{
+  if (primary)
+  {
+    const int previous = m_primaryIndex;
+    if (previous == index)
+      return;
+    if (previous >= 0)
+      m_outputs[previous].primary = false;
+    m_outputs[index].primary = true;
+    m_primaryIndex = index;
+    if (previous >= 0)
+      emit outputChanged(previous);
+  }
+  else
+  {
+    if (!m_outputs.at(index).primary)
+      return;
+    m_outputs[index].primary = false;
+    m_primaryIndex = -1;
+  }
+  emit outputChanged(index);
+}
+
+void LayoutModel::setTouchDevice(int index, const QString &idPath, const QString &name)
+{
+  LayoutOutput &out = m_outputs[index];
+  out.touchIdPath = idPath;
+  out.touchName = name;
+  emit outputChanged(index);
+}
+
+void LayoutModel::setProperty(int index, const QString &name, const QString &value)
+{
+  LayoutOutput &out = m_outputs[index];
+  if (out.properties.value(name) == value)
+    return;
+  out.properties.insert(name, value);
+  emit outputChanged(index);
+}
+
+void LayoutModel::setCloneOf(int index, const QString &source)
+{
+  int sourceIndex = indexOf(source);
+  // Mirroring a clone means mirroring what it shows.
+  if (sourceIndex >= 0 && m_outputs.at(sourceIndex).isClone())
+    sourceIndex = indexOf(m_outputs.at(sourceIndex).cloneOf);
+  if (sourceIndex == index || (!source.isEmpty() && sourceIndex < 0))
+    return;
+  // Each tile needs a CRTC of its own, so tiled displays are never mirrored.
+  if (m_outputs.at(index).isTiled() || (sourceIndex >= 0 && m_outputs.at(sourceIndex).isTiled()))
+    return;
+  const QString sourceName = sourceIndex >= 0 ? m_outputs.at(sourceIndex).name : QString();
+  LayoutOutput &out = m_outputs[index];
+  if (out.cloneOf == sourceName)
+    return;
+  if (sourceName.isEmpty())
+  {
+    // Place it next to the layout instead of on top of the picture it showed.
+    out.cloneOf.clear();
+    const QRect all = bounds();
+    out.position = QPoint(all.x() + all.width(), all.y());
+  }
+  else
+  {
+    for (LayoutOutput &other : m_outputs)
+    {
+      if (other.cloneOf == out.name)
+        other.cloneOf = sourceName;
+    }
+    out.cloneOf = sourceName;
+  }
+  syncClones();
+  emit layoutChanged();
+}
+
+int LayoutModel::cloneSource(int index) const
+{
+  const LayoutOutput &out = m_outputs.at(index);
+  if (!out.isClone())
+    return index;
+  const int source = indexOf(out.cloneOf);
+  return source >= 0 ? source : index;
+}
+
+void LayoutModel::detectClones()
+{
+  const auto &map = XRandrBackend::instance().monitors();
+  bool changed = false;
+  for (int i = 0; i < m_outputs.size(); ++i)
+  {
+    LayoutOutput &out = m_outputs[i];
+    const int crtc = map.value(out.name).crtc;
+    if (out.isClone() || out.isTiled() || crtc < 0)
+      continue;
+    for (int j = 0; j < i; ++j)
+    {
+      const LayoutOutput &other = m_outputs.at(j);
+      const int otherCrtc = map.value(other.name).crtc;
+      if (other.isClone() || other.isTiled() || otherCrtc < 0)
+        continue;
+      if (otherCrtc == crtc || other.rect() == out.rect())
+      {
+        out.cloneOf = other.name;
+        changed = true;
+        break;
+      }
+    }
+  }
+  if (!changed)
+    return;
+  syncClones();
+  emit layoutChanged();
+}
+
+QRect LayoutModel::rect(int index) const
+{
+  const LayoutOutput &out = m_outputs.at(index);
+  const int source = cloneSource(index);
+  if (source == index)
+    return out.rect();
+  return QRect(out.position, m_outputs.at(source).size());
+}
+
+QList<QRect> LayoutModel::rects() const
+{
+  QList<QRect> result;
+  result.reserve(m_outputs.size());
+  for (int i = 0; i < m_outputs.size(); ++i)
+    result.append(rect(i));
+  return result;
+}
+
+QRect LayoutModel::bounds() const
+{
+  QRect result;
+  for (int i = 0; i < m_outputs.size(); ++i)
+    result = result.united(rect(i));
+  return result;
+}
+
+QRect LayoutModel::bounds(const QList<int> &indices) const
+{
+  QRect result;
+  for (int index : indices)
+    result = result.united(rect(index));
+  return result;
+}
+
+QList<XRandrMonitorConfig> LayoutModel::xrandrConfigs() const
+{
+  // Only clones need the RandR state of the X server.
+  for (const LayoutOutput &out : m_outputs)
+  {
+    if (out.isClone())
+      return xrandrConfigs(XRandrBackend::instance().monitors());
+  }
+  return xrandrConfigs(QHash<QString, XRandrMonitorInfo>());
+}
+
+QList<XRandrMonitorConfig> LayoutModel::xrandrConfigs(const QHash<QString, XRandrMonitorInfo> &monitors) const
+{
+  // The X screen starts at 0,0; shift the layout so its top-left output is there.
+  const QPoint origin = bounds().topLeft();
+  QList<XRandrMonitorConfig> configs;
+  configs.reserve(m_outputs.size());
+  bool hasClones = false;
+  for (const LayoutOutput &out : m_outputs)
+  {
+    XRandrMonitorConfig cfg;
+    cfg.screenName = out.name;
+    cfg.resolution = out.mode;
+    cfg.position = out.position - origin;
+    cfg.orientation = orientationToString(out.orientation);
+    cfg.reflection = reflectionToString(out.reflection);
+    cfg.emulatedRotation = out.isRotationEmulated();
+    cfg.isPrimary = out.primary;
+    cfg.isCustom = out.isCustomMode();
+    cfg.properties = out.properties;
+    cfg.cloneOf = out.cloneOf;
+    if (out.isTiled())
+    {
+      // One config per tile at its native timing, joined into one RandR monitor.
+      for (int t = 0; t < out.tiles.size(); ++t)
+      {
+        const LayoutTile &tile = out.tiles.at(t);
+        XRandrMonitorConfig tileCfg = cfg;
+        tileCfg.screenName = tile.output;
+        tileCfg.resolution = tile.rect.size();
+        tileCfg.position = cfg.position + out.tileRect(tile).topLeft();
+        tileCfg.isPrimary = out.primary && t == 0;
+        tileCfg.isCustom = false;
+        tileCfg.rate = tile.refreshRate;
+        tileCfg.monitor = out.name;
+        configs.append(tileCfg);
+      }
+      continue;
+    }
+    configs.append(cfg);
+    hasClones = hasClones || out.isClone();
+  }
+  // Whether a clone can share the CRTC of its source depends on the GPU.
+  if (hasClones)
+    XRandrBackend::planClones(configs, monitors);
+  return configs;
+}
+
+QList<XInputDeviceConfig> LayoutModel::xinputConfigs() const
+{
+  const QRect screen = bounds();
+  QList<XInputDeviceConfig> configs;
+  configs.reserve(m_outputs.size());
+  for (int i = 0; i < m_outputs.size(); ++i)
+  {
+    const LayoutOutput &out = m_outputs.at(i);
+    XInputDeviceConfig cfg;
+    cfg.idPath = out.touchIdPath;
+    cfg.deviceName = out.touchName;
+    cfg.outputName = out.name;
+    cfg.orientation = out.orientation;
+    cfg.reflection = out.reflection;
+    cfg.totalSize = screen.size();
+    // The touch area of a clone is the picture of its source.
+    cfg.monitorRect = QRect(out.position - screen.topLeft(), m_outputs.at(cloneSource(i)).mode);
+    configs.append(cfg);
+  }
+  return configs;
+}
+
+void LayoutModel::loadFromSystem()
+{
+  TraceScope scope("LayoutModel::loadFromSystem");
+  const QStringList names = XRandrBackend::instance().connectedMonitorNames();
+  const auto &map = XRandrBackend::instance().monitors();
+
+  QList<LayoutOutput> outputs;
+  outputs.reserve(names.size());
+  for (const QString &name : names)
+  {
+    const XRandrMonitorInfo &info = map.value(name);
+    const int tiled = tiledOutput(outputs, info);
+    if (tiled >= 0)
+      addTile(outputs[tiled], name, info);
+    else
+      outputs.append(outputFromInfo(name, info));
+  }
+  setOutputs(outputs);
+  detectClones();
+
+  const QHash<QString, XInputDevice> mappings = storedTouchMappings();
+  // Only probe the input devices when a mapping has to be verified.
+  if (!mappings.isEmpty())
+    attachTouchDevices(mappings, XInputBackend::instance().devices());
+}
+
+void LayoutModel::appendOutput(const QString &name, const XRandrMonitorInfo &info)
+{
+  const int tiled = tiledOutput(m_outputs, info);
+  if (tiled >= 0)
+  {
+    addTile(m_outputs[tiled], name, info);
+    m_indexByName.insert(name, tiled);
+    emit outputChanged(tiled);
+    return;
+  }
+  LayoutOutput out = outputFromInfo(name, info);
+  const int index = m_outputs.size();
+  if (out.primary)
+  {
+    if (m_primaryIndex >= 0)
+      out.primary = false;
+    else
+      m_primaryIndex = index;
+  }
+  m_outputs.append(out);
+  m_indexByName.insert(out.name, index);
+  emit outputAdded(index);
+}
+
+QHash<QString, XInputDevice> LayoutModel::storedTouchMappings()
+{
+  TraceScope settingsScope("QSettings TouchDeviceMappings", "settings");
+  QHash<QString, XInputDevice> mappings;
+  QSettings settings(kSettingsOrganization, kSettingsApplication);
+  settings.beginGroup("TouchDeviceMappings");
+  const QStringList keys = settings.childKeys();
+  for (const QString &name : keys)
+  {
+    const QStringList parts = settings.value(name).toString().split("||");
+    if (parts.size() < 2 || parts.at(0).trimmed().isEmpty())
+      continue;
+    XInputDevice device;
+    device.idPath = parts.at(0).trimmed();
+    device.name = parts.at(1).trimmed();
+    mappings.insert(name, device);
+  }
+  settings.endGroup();
+  return mappings;
+}
+
+void LayoutModel::attachTouchDevices(const QHash<QString, XInputDevice> &mappings,
+                                     const QList<XInputDevice> &devices)
+{
+  for (int i = 0; i < m_outputs.size(); ++i)
+  {
+    auto mapping = mappings.constFind(m_outputs.at(i).name);
+    if (mapping == mappings.constEnd())
+      continue;
+    // Only keep mappings to devices that are actually present.
+    for (const XInputDevice &dev : devices)
+    {
+      if (dev.idPath == mapping->idPath && dev.name == mapping->name)
+      {
+        setTouchDevice(i, dev.idPath, dev.name);
+        break;
+      }
+    }
+  }
+}
+
+void LayoutModel::updateFromBackend()
+{
+  const auto &map = XRandrBackend::instance().monitors();
+  for (LayoutOutput &out : m_outputs)
+  {
+    auto it = map.constFind(out.name);
+    if (it != map.constEnd() && it->connected)
+      applyMonitorInfo(out, *it);
+    if (!out.isTiled())
+      continue;
+    const QList<LayoutTile> tiles = out.tiles;
+    out.tiles.clear();
+    for (const LayoutTile &tile : tiles)
+    {
+      auto info = map.constFind(tile.output);
+      if (info != map.constEnd() && info->connected && info->tile.isValid())
+        addTile(out, tile.output, *info);
+    }
+  }
+  rebuildIndex();
+  syncClones();
+  emit layoutChanged();
+}
+
+void LayoutModel::saveTouchMapping(int index) const
+{
+  const LayoutOutput &out = m_outputs.at(index);
+  QSettings settings(kSettingsOrganization, kSettingsApplication);
+  settings.beginGroup("TouchDeviceMappings");
+  settings.setValue(out.name, out.touchIdPath + "||" + out.touchName);
+  settings.endGroup();
+}
+
+QJsonObject LayoutModel::toJson() const
+{
+  QJsonArray outputs;
+  for (const LayoutOutput &out : m_outputs)
+  {
+    QJsonObject obj;
+    obj.insert("name", out.name);
+    obj.insert("x", out.position.x());
+    obj.insert("y", out.position.y());
+    obj.insert("mode", sizeToString(out.mode));
+    obj.insert("orientation", orientationToString(out.orientation));
+    if (out.reflection != Reflection::None)
+      obj.insert("reflection", reflectionToString(out.reflection));
+    if (!out.nativeRotations.isEmpty())
+    {
+      QJsonArray rotations;
+      for (Orientation orient : out.nativeRotations)
+        rotations.append(orientationToString(orient));
+      if (out.canReflectX)
+        rotations.append("x");
+      if (out.canReflectY)
+        rotations.append("y");
+      obj.insert("rotations", rotations);
+    }
+    obj.insert("primary", out.primary);
+    if (out.isClone())
+      obj.insert("cloneOf", out.cloneOf);
+    if (out.isTiled())
+    {
+      QJsonArray tiles;
+      for (const LayoutTile &tile : out.tiles)
+      {
+        tiles.append(QJsonObject{{"output", tile.output},
+                                 {"x", tile.rect.x()},
+                                 {"y", tile.rect.y()},
+                                 {"mode", sizeToString(tile.rect.size())},
+                                 {"rate", tile.refreshRate}});
+      }
+      obj.insert("tileGroup", out.tileGroup);
+      obj.insert("tiles", tiles);
+    }
+    QJsonArray modes;
+    for (const QSize &mode : out.availableModes)
+      modes.append(sizeToString(mode));
+    obj.insert("modes", modes);
+    if (!out.properties.isEmpty())
+    {
+      QJsonObject properties;
+      for (auto it = out.properties.constBegin(); it != out.properties.constEnd(); ++it)
+        properties.insert(it.key(), it.value());
+      obj.insert("properties", properties);
+    }
+    if (out.hasTouchDevice())
+      obj.insert("touch", QJsonObject{{"idPath", out.touchIdPath}, {"name", out.touchName}});
+    outputs.append(obj);
+  }
+  QJsonObject root;
+  root.insert("version", 1);
+  root.insert("outputs", outputs);
+  return root;
+}
+
+bool LayoutModel::fromJson(const QJsonObject &json)
+{
+  const QJsonArray array = json.value("outputs").toArray();
+  if (array.isEmpty())
+    return false;
+
+  QList<LayoutOutput> outputs;
+  outputs.reserve(array.size());
+  for (const QJsonValue &value : array)
+  {
+    const QJsonObject obj = value.toObject();
+    LayoutOutput out;
+    out.name = obj.value("name").toString();
+    out.position = QPoint(obj.value("x").toInt(), obj.value("y").toInt());
+    out.mode = sizeFromString(obj.value("mode").toString());
+    out.orientation = stringToOrientation(obj.value("orientation").toString("normal"));
+    out.reflection = stringToReflection(obj.value("reflection").toString("normal"));
+    const QJsonArray rotations = obj.value("rotations").toArray();
+    for (const QJsonValue &rotation : rotations)
+    {
+      const QString name = rotation.toString();
+      if (name == "x")
+        out.canReflectX = true;
+      else if (name == "y")
+        out.canReflectY = true;
+      else
+        out.nativeRotations.append(stringToOrientation(name));
+    }
+    out.primary = obj.value("primary").toBool();
+    out.cloneOf = obj.value("cloneOf").toString();
+    out.tileGroup = obj.value("tileGroup").toInt(-1);
+    const QJsonArray tiles = obj.value("tiles").toArray();
+    for (const QJsonValue &value : tiles)
+    {
+      const QJsonObject tileObj = value.toObject();
+      LayoutTile tile;
+      tile.output = tileObj.value("output").toString();
+      tile.rect = QRect(QPoint(tileObj.value("x").toInt(), tileObj.value("y").toInt()),
+                        sizeFromString(tileObj.value("mode").toString()));
+      tile.refreshRate = tileObj.value("rate").toDouble();
+      if (tile.output.isEmpty() || !tile.rect.isValid())
+        return false;
+      out.tiles.append(tile);
+    }
+    const QJsonArray modes = obj.value("modes").toArray();
+    for (const QJsonValue &mode : modes)
+      out.availableModes.append(sizeFromString(mode.toString()));
+    const QJsonObject properties = obj.value("properties").toObject();
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+      out.properties.insert(it.key(), it.value().toString());
+    const QJsonObject touch = obj.value("touch").toObject();
+    out.touchIdPath = touch.value("idPath").toString();
+    out.touchName = touch.value("name").toString();
+    if (out.name.isEmpty() || !out.mode.isValid())
+      return false;
+    outputs.append(out);
+  }
+  setOutputs(outputs);
+  return true;
+}
+
+void LayoutModel::rebuildIndex()
+{
+  m_indexByName.clear();
+  m_primaryIndex = -1;
+  for (int i = 0; i < m_outputs.size(); ++i)
+  {
+    for (const LayoutTile &tile : m_outputs.at(i).tiles)
+      m_indexByName.insert(tile.output, i);
+    m_indexByName.insert(m_outputs.at(i).name, i);
+    if (m_outputs.at(i).primary)
+    {
+      // Only one output can be primary.
+      if (m_primaryIndex >= 0)
+        m_outputs[i].primary = false;
+      else
+        m_primaryIndex = i;
+    }
+  }
+  // Clones of clones, of tiled displays or of outputs that are gone show
+  // their own picture.
+  for (LayoutOutput &out : m_outputs)
+  {
+    const int source = indexOf(out.cloneOf);
+    if (out.isClone() && (source < 0 || m_outputs.at(source).isClone() || m_outputs.at(source).isTiled()
+                          || out.isTiled() || out.cloneOf == out.name))
+      out.cloneOf.clear();
+  }
+}
+
+QList<int> LayoutModel::syncClones()
+{
+  QList<int> changed;
+  for (int i = 0; i < m_outputs.size(); ++i)
+  {
+    const int source = cloneSource(i);
+    if (source == i)
+      continue;
+    const LayoutOutput &src = m_outputs.at(source);
+    LayoutOutput &out = m_outputs[i];
+    if (out.position == src.position && out.orientation == src.orientation && out.reflection == src.reflection)
+      continue;
+    out.position = src.position;
+    out.orientation = src.orientation;
+    out.reflection = src.reflection;
+    changed << i;
+  }
+  return changed;
+}
+
+LayoutOutput LayoutModel::outputFromInfo(const QString &name, const XRandrMonitorInfo &info)
+{
+  LayoutOutput out;
+  out.name = name;
+  out.mode = QSize(1024, 768);
+  applyMonitorInfo(out, info);
+  if (info.tile.isValid())
+    addTile(out, name, info);
+  return out;
+}
+
+void LayoutModel::applyMonitorInfo(LayoutOutput &output, const XRandrMonitorInfo &info)
+{
+  if (info.currentResolution.isValid())
+    output.mode = info.currentResolution;
+  output.position = info.position;
+  output.orientation = info.orientation;
+  output.reflection = info.reflection;
+  output.nativeRotations = info.rotations;
+  output.canReflectX = info.canReflectX;
+  output.canReflectY = info.canReflectY;
+  output.primary = info.isPrimary;
+  output.availableModes = info.allResolutions;
+  output.properties.clear();
+  for (auto it = info.properties.constBegin(); it != info.properties.constEnd(); ++it)
+  {
+    if (XRandrBackend::tunableProperties().contains(it.key()))
+      output.properties.insert(it.key(), it->value);
+  }
+}
+
+int LayoutModel::tiledOutput(const QList<LayoutOutput> &outputs, const XRandrMonitorInfo &info)
+{
+  if (!info.tile.isValid())
+    return -1;
+  for (int i = 0; i < outputs.size(); ++i)
+  {
+    if (outputs.at(i).tileGroup == info.tile.group)
+      return i;
+  }
+  return -1;
+}
+
+void LayoutModel::addTile(LayoutOutput &output, const QString &name, const XRandrMonitorInfo &info)
+{
+  const XRandrTile &tile = info.tile;
+  LayoutTile layoutTile;
+  layoutTile.output = name;
+  layoutTile.rect = QRect(QPoint(tile.column * tile.size.width(), tile.row * tile.size.height()), tile.size);
+  // The native timing of a tile is its preferred mode.
+  const Modeline &preferred = info.preferredMode;
+  const Modeline &current = info.currentMode;
+  if (preferred.hDisplay == tile.size.width() && preferred.vDisplay == tile.size.height())
+    layoutTile.refreshRate = preferred.refreshRate();
+  else if (current.hDisplay == tile.size.width() && current.vDisplay == tile.size.height())
+    layoutTile.refreshRate = current.refreshRate();
+  output.tileGroup = tile.group;
+  output.tiles.append(layoutTile);
+  if (!output.isTiled())
+    return;
+  output.mode = QSize(tile.columns * tile.size.width(), tile.rows * tile.size.height());
+  output.availableModes = {output.mode};
+  // The tiles cover the display, so its corner is the smallest tile position.
+  if (info.currentResolution.isValid())
+  {
+    output.position.setX(qMin(output.position.x(), info.position.x()));
+    output.position.setY(qMin(output.position.y(), info.position.y()));
+  }
+}
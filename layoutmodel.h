@@ -0,0 +1,145 @@
+#pragma once
+
+#include <QtCore>
+#include "orientation.h"
+#include "xinputbackend.h"
+#include "xrandrbackend.h"
+
+// One output driving a part of a tiled display.
+struct LayoutTile
+{
+  QString output;
+  // Area on the unrotated panel, in pixels of the whole display.
+  QRect rect;
+  // Native refresh rate of the tile; 0 when unknown.
+  double refreshRate = 0.0;
+};
+
+struct LayoutOutput
+{
+  QString name;
+  QPoint position;
+  QSize mode;
+  Orientation orientation = Orientation::Normal;
+  Reflection reflection = Reflection::None;
+  bool primary = false;
+  QList<QSize> availableModes;
+  QString touchIdPath;
+  QString touchName;
+  // Tunable RandR output properties, see XRandrBackend::tunableProperties().
+  QMap<QString, QString> properties;
+  // Rotations and reflections the CRTC does itself. The other rotations go
+  // through a transform, which the X server renders into a shadow framebuffer.
+  QList<Orientation> nativeRotations;
+  bool canReflectX = false;
+  bool canReflectY = false;
+  // Output whose picture this one shows; empty for an independent output.
+  // A clone follows the position, rotation and reflection of its source.
+  QString cloneOf;
+  // A display made of several tiles, e.g. a 5K panel fed by two streams,
+  // is one output named after its first tile. Each tile is driven at its
+  // native timing; the mode is that of the whole display.
+  int tileGroup = -1;
+  QList<LayoutTile> tiles;
+
+  // Extent on the X screen, i.e. the mode size after rotation.
+  QSize size() const;
+  QRect rect() const { return QRect(position, size()); }
+  bool isCustomMode() const { return !availableModes.contains(mode); }
+  bool hasTouchDevice() const { return !touchIdPath.isEmpty() && !touchName.isEmpty(); }
+  // Without information from xrandr every rotation counts as native.
+  bool isNativeRotation(Orientation o) const { return nativeRotations.isEmpty() || nativeRotations.contains(o); }
+  bool isRotationEmulated() const { return !isNativeRotation(orientation); }
+  bool isClone() const { return !cloneOf.isEmpty(); }
+  bool isTiled() const { return tiles.size() > 1; }
+  // Extent of the tile on the X screen, relative to the position.
+  QRect tileRect(const LayoutTile &tile) const;
+};
+
+// Pixel-exact layout of all outputs, kept in one contiguous array indexed by
+// output. MonitorItem is only a view onto it; script building, touch matrices
+// and validation run on the model alone, so it also works without a scene.
+class LayoutModel : public QObject
+{
+  Q_OBJECT
+public:
+  explicit LayoutModel(QObject *parent = nullptr);
+
+  int count() const { return m_outputs.size(); }
+  const LayoutOutput &output(int index) const { return m_outputs.at(index); }
+  const QList<LayoutOutput> &outputs() const { return m_outputs; }
+  // The tiles of a tiled display are found under their own names as well.
+  int indexOf(const QString &name) const { return m_indexByName.value(name, -1); }
+  int primaryIndex() const { return m_primaryIndex; }
+
+  void setOutputs(const QList<LayoutOutput> &outputs);
+  void setPosition(int index, const QPoint &position);
+  void setPositions(const QList<QPoint> &positions);
+  void setPositions(const QList<int> &indices, const QList<QPoint> &positions);
+  void setMode(int index, const QSize &mode);
+  void setOrientation(int index, Orientation orientation);
+  void setReflection(int index, Reflection reflection);
+  void setPrimary(int index, bool primary);
+  void setTouchDevice(int index, const QString &idPath, const QString &name);
+  void setProperty(int index, const QString &name, const QString &value);
+  // Makes the output show the picture of source; an empty source ends the mirroring.
+  void setCloneOf(int index, const QString &source);
+  // Index of the output whose picture the output shows, the output itself when it is no clone.
+  int cloneSource(int index) const;
+  // Turns outputs that share a CRTC, or cover exactly the same area, into clones.
+  void detectClones();
+
+  // Group operations; the outputs keep their arrangement relative to each other.
+  void alignOutputs(const QList<int> &indices, Qt::Alignment edge);
+  void arrangeOutputs(const QList<int> &indices, Qt::Orientation direction);
+  // Rotates the group as a whole, as if the panels were physically turned clockwise.
+  void rotateOutputs(const QList<int> &indices, int clockwiseTurns);
+
+  // Extent on the X screen. A clone covers the area of its source, also when
+  // its own mode differs and the picture is scaled.
+  QRect rect(int index) const;
+  QList<QRect> rects() const;
+  QRect bounds() const;
+  QRect bounds(const QList<int> &indices) const;
+  QList<XRandrMonitorConfig> xrandrConfigs() const;
+  // Plans the clones with the given RandR state, e.g. from a manifest,
+  // instead of querying the X server.
+  QList<XRandrMonitorConfig> xrandrConfigs(const QHash<QString, XRandrMonitorInfo> &monitors) const;
+  QList<XInputDeviceConfig> xinputConfigs() const;
+
+  // Reads the connected outputs from XRandrBackend and the stored touch mappings.
+  void loadFromSystem();
+  // Adds one output while a layout is streamed in, see LayoutLoader.
+  void appendOutput(const QString &name, const XRandrMonitorInfo &info);
+  // Saved output name -> touch device pairs, unverified.
+  static QHash<QString, XInputDevice> storedTouchMappings();
+  // Maps the outputs to their saved touch devices that are present in devices.
+  void attachTouchDevices(const QHash<QString, XInputDevice> &mappings, const QList<XInputDevice> &devices);
+  // Takes over the geometry the X server reports, keeping the touch mappings.
+  void updateFromBackend();
+  // Stores the touch device of one output; the saved mappings of the other
+  // outputs stay as they are, also when their device is unplugged now.
+  void saveTouchMapping(int index) const;
+
+  QJsonObject toJson() const;
+  bool fromJson(const QJsonObject &json);
+
+signals:
+  void outputChanged(int index);
+  void outputAdded(int index);
+  void layoutChanged();
+
+private:
+  QList<LayoutOutput> m_outputs;
+  QHash<QString, int> m_indexByName;
+  int m_primaryIndex = -1;
+
+  void rebuildIndex();
+  // Moves the clones along with their sources; returns the clones that changed.
+  QList<int> syncClones();
+  static LayoutOutput outputFromInfo(const QString &name, const XRandrMonitorInfo &info);
+  static void applyMonitorInfo(LayoutOutput &output, const XRandrMonitorInfo &info);
+  // Index of the output that already holds other tiles of the display, or -1.
+  static int tiledOutput(const QList<LayoutOutput> &outputs, const XRandrMonitorInfo &info);
+  static void addTile(LayoutOutput &output, const QString &name, const XRandrMonitorInfo &info);
+};
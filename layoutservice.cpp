@@ -0,0 +1,273 @@
+#include "layoutservice.h"
+#include "tracer.h"
+#include "xinputbackend.h"
+#include "xrandrbackend.h"
+#include <QtGui>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+namespace
+{
+  QString sizeToString(const QSize &size)
+  {
+    return QString("%1x%2").arg(size.width()).arg(size.height());
+  }
+}
+
+LayoutService::LayoutService(QObject *parent)
+:QObject(parent)
+{
+  m_server = new QLocalServer(this);
+  m_server->setSocketOptions(QLocalServer::UserAccessOption);
+  connect(m_server, &QLocalServer::newConnection, this, &LayoutService::onNewConnection);
+
+  m_refreshProcess = new QProcess(this);
+  connect(m_refreshProcess, &QProcess::finished, this, &LayoutService::onRefreshFinished);
+
+  // RandR reports a reconfiguration as a burst of notifications; read the
+  // state once they have stopped arriving.
+  m_screenSettle.setSingleShot(true);
+  m_screenSettle.setInterval(kScreenSettleDelay);
+  connect(&m_screenSettle, &QTimer::timeout, this, &LayoutService::startRefresh);
+
+  // A replugged panel enumerates as several devices; probe once they are in.
+  XInputBackend &xinput = XInputBackend::instance();
+  m_deviceSettle.setSingleShot(true);
+  m_deviceSettle.setInterval(kDeviceSettleDelay);
+  connect(&m_deviceSettle, &QTimer::timeout, &xinput, &XInputBackend::reloadInBackground);
+  connect(&m_touchWatcher, &TouchWatcher::devicesChanged, &m_deviceSettle, qOverload<>(&QTimer::start));
+  connect(&xinput, &XInputBackend::devicesLoaded, this, &LayoutService::onDevicesLoaded);
+
+  m_model.loadFromSystem();
+  rebuildReplies();
+  watchScreens();
+  if (m_touchWatcher.start())
+    m_touchWatcher.setMappings(m_model.xinputConfigs());
+  xinput.loadInBackground();
+}
+
+QString LayoutService::defaultSocketPath()
+{
+  QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+  if (dir.isEmpty())
+    dir = QDir::tempPath();
+  return dir + "/dpset.sock";
+}
+
+bool LayoutService::listen(const QString &path)
+{
+  if (m_server->listen(path))
+    return true;
+
+  if (m_server->serverError() == QAbstractSocket::AddressInUseError)
+  {
+    // Remove the socket left behind by a crashed instance, but never steal
+    // the socket of one that is still running.
+    QLocalSocket probe;
+    probe.connectToServer(path);
+    if (probe.waitForConnected(200))
+    {
+      qWarning() << "Another dpset instance is already serving" << path;
+      return false;
+    }
+    QLocalServer::removeServer(path);
+    if (m_server->listen(path))
+      return true;
+  }
+  qWarning() << "Cannot listen on" << path << ":" << m_server->errorString();
+  return false;
+}
+
+void LayoutService::watchScreens()
+{
+  auto *guiApp = qobject_cast<QGuiApplication *>(QCoreApplication::instance());
+  if (!guiApp)
+    return;
+  auto onChanged = [this]() { m_screenSettle.start(); };
+  auto watchScreen = [this, onChanged](QScreen *screen)
+  {
+    connect(screen, &QScreen::geometryChanged, this, onChanged);
+  };
+  for (QScreen *screen : QGuiApplication::screens())
+    watchScreen(screen);
+  connect(guiApp, &QGuiApplication::screenAdded, this, [watchScreen, onChanged](QScreen *screen)
+  {
+    watchScreen(screen);
+    onChanged();
+  });
+  connect(guiApp, &QGuiApplication::screenRemoved, this, onChanged);
+  connect(guiApp, &QGuiApplication::primaryScreenChanged, this, onChanged);
+}
+
+void LayoutService::startRefresh()
+{
+  if (m_refreshProcess->state() != QProcess::NotRunning)
+  {
+    m_refreshPending = true;
+    return;
+  }
+  m_refreshPending = false;
+  // --current returns the server's state without probing the outputs again.
+  m_refreshProcess->start("xrandr", {"--current", "--verbose"});
+}
+
+void LayoutService::onRefreshFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+  if (exitStatus != QProcess::NormalExit || exitCode != 0)
+  {
+    qWarning() << "xrandr --current failed:" << m_refreshProcess->readAllStandardError();
+  }
+  else
+  {
+    TraceScope scope("LayoutService::refresh");
+    XRandrBackend::instance().parseQueryOutput(m_refreshProcess->readAllStandardOutput());
+    m_model.loadFromSystem();
+    rebuildReplies();
+    // The matrices depend on the output geometry.
+    m_touchWatcher.setMappings(m_model.xinputConfigs());
+    for (QLocalSocket *socket : std::as_const(m_subscribers))
+      socket->write(m_changedEvent);
+    m_deviceSettle.start();
+  }
+  if (m_refreshPending)
+    startRefresh();
+}
+
+void LayoutService::onDevicesLoaded()
+{
+  // The probe has finished, so this does not block.
+  m_inputDevices = XInputBackend::instance().devices();
+  rebuildReplies();
+}
+
+void LayoutService::rebuildReplies()
+{
+  ++m_generation;
+
+  QJsonArray outputs;
+  const auto &monitors = XRandrBackend::instance().monitors();
+  for (auto it = monitors.constBegin(); it != monitors.constEnd(); ++it)
+  {
+    const XRandrMonitorInfo &info = it.value();
+    QJsonObject obj;
+    obj.insert("name", it.key());
+    obj.insert("connected", info.connected);
+    if (info.connected)
+    {
+      obj.insert("primary", info.isPrimary);
+      obj.insert("x", info.position.x());
+      obj.insert("y", info.position.y());
+      obj.insert("mode", sizeToString(info.currentResolution));
+      obj.insert("orientation", orientationToString(info.orientation));
+      obj.insert("reflection", reflectionToString(info.reflection));
+      obj.insert("emulatedRotation", info.emulatedRotation);
+      // Outputs that mirror each other on one CRTC report the same number.
+      obj.insert("crtc", info.crtc);
+      // Lets a manifest for --batch be filled from the running consoles.
+      if (!info.edidFingerprint.isEmpty())
+        obj.insert("edid", info.edidFingerprint);
+      if (info.tile.isValid())
+      {
+        obj.insert("tile", QJsonObject{{"group", info.tile.group},
+                                       {"columns", info.tile.columns},
+                                       {"rows", info.tile.rows},
+                                       {"column", info.tile.column},
+                                       {"row", info.tile.row},
+                                       {"size", sizeToString(info.tile.size)}});
+      }
+      QJsonArray modes;
+      for (const QSize &mode : info.allResolutions)
+        modes.append(sizeToString(mode));
+      obj.insert("modes", modes);
+      QJsonObject properties;
+      for (auto prop = info.properties.constBegin(); prop != info.properties.constEnd(); ++prop)
+        properties.insert(prop.key(), prop->value);
+      obj.insert("properties", properties);
+    }
+    outputs.append(obj);
+  }
+  m_outputsReply = withGeneration(QJsonObject{{"outputs", outputs}});
+
+  QHash<QString, QString> mappedOutput;
+  for (const LayoutOutput &out : m_model.outputs())
+  {
+    if (out.hasTouchDevice())
+      mappedOutput.insert(out.touchIdPath + "||" + out.touchName, out.name);
+  }
+  QJsonArray devices;
+  for (const XInputDevice &dev : std::as_const(m_inputDevices))
+  {
+    const QString output = mappedOutput.value(dev.idPath + "||" + dev.name);
+    QJsonObject obj;
+    obj.insert("name", dev.name);
+    obj.insert("idPath", dev.idPath);
+    obj.insert("output", output.isEmpty() ? QJsonValue() : QJsonValue(output));
+    devices.append(obj);
+  }
+  m_devicesReply = withGeneration(QJsonObject{{"devices", devices}});
+
+  m_layoutReply = withGeneration(m_model.toJson());
+  QJsonObject event = m_model.toJson();
+  event.insert("event", "changed");
+  m_changedEvent = withGeneration(event);
+}
+
+QByteArray LayoutService::withGeneration(QJsonObject object) const
+{
+  object.insert("generation", qint64(m_generation));
+  return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+}
+
+void LayoutService::onNewConnection()
+{
+  while (QLocalSocket *socket = m_server->nextPendingConnection())
+  {
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+    connect(socket, &QLocalSocket::disconnected, this, [this, socket]()
+    {
+      m_subscribers.removeOne(socket);
+      socket->deleteLater();
+    });
+  }
+}
+
+void LayoutService::onReadyRead(QLocalSocket *socket)
+{
+  while (socket->canReadLine())
+  {
+    const QByteArray request = socket->readLine().trimmed();
+    if (!request.isEmpty())
+      socket->write(reply(socket, request));
+  }
+  if (socket->bytesAvailable() > kMaxRequestLength)
+  {
+    qWarning() << "Dropping client with an oversized request.";
+    socket->abort();
+  }
+}
+
+QByteArray LayoutService::reply(QLocalSocket *socket, const QByteArray &request)
+{
+  if (request == "outputs")
+    return m_outputsReply;
+  if (request == "devices")
+    return m_devicesReply;
+  if (request == "layout")
+    return m_layoutReply;
+  if (request == "subscribe")
+  {
+    if (!m_subscribers.contains(socket))
+      m_subscribers.append(socket);
+    return withGeneration(QJsonObject{{"subscribed", true}});
+  }
+  if (request == "unsubscribe")
+  {
+    m_subscribers.removeOne(socket);
+    return withGeneration(QJsonObject{{"subscribed", false}});
+  }
+  if (request == "ping")
+    return "{\"pong\":true}\n";
+  return QJsonDocument(QJsonObject{{"error", "unknown request"},
+                                   {"request", QString::fromUtf8(request)}})
+             .toJson(QJsonDocument::Compact) + '\n';
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QtCore>
+#include "layoutmodel.h"
+#include "touchwatcher.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+// Serves the cached display layout over a local socket, so other programs do
+// not have to run xrandr or xinput themselves. The protocol is line based:
+// each request is one command word, each reply one line of compact JSON.
+//
+//   outputs      all outputs known to RandR with geometry and modes
+//   devices      the input devices and the output they are mapped to
+//   layout       the layout profile (see LayoutModel::toJson())
+//   subscribe    push {"event":"changed", ...layout} after every change
+//   unsubscribe  stop the change notifications
+//   ping         {"pong":true}
+//
+// The service also keeps the touch mappings applied when devices reappear.
+//
+// Replies are serialized once per change, so answering costs a single write.
+// The input devices are probed again on a worker thread whenever the screens
+// or the XInput hierarchy change; each new list bumps the generation.
+class LayoutService : public QObject
+{
+  Q_OBJECT
+public:
+  explicit LayoutService(QObject *parent = nullptr);
+
+  static QString defaultSocketPath();
+  bool listen(const QString &path);
+
+private:
+  static constexpr int kScreenSettleDelay = 150;
+  static constexpr int kDeviceSettleDelay = 500;
+  static constexpr int kMaxRequestLength = 256;
+
+  QLocalServer *m_server = nullptr;
+  QProcess *m_refreshProcess = nullptr;
+  LayoutModel m_model;
+  TouchWatcher m_touchWatcher;
+  QList<QLocalSocket *> m_subscribers;
+  QList<XInputDevice> m_inputDevices;
+  quint64 m_generation = 0;
+  QByteArray m_outputsReply;
+  QByteArray m_devicesReply;
+  QByteArray m_layoutReply;
+  QByteArray m_changedEvent;
+  QTimer m_screenSettle;
+  QTimer m_deviceSettle;
+  bool m_refreshPending = false;
+
+  void watchScreens();
+  void startRefresh();
+  void onRefreshFinished(int exitCode, QProcess::ExitStatus exitStatus);
+  void onDevicesLoaded();
+  void rebuildReplies();
+  void onNewConnection();
+  void onReadyRead(QLocalSocket *socket);
+  QByteArray reply(QLocalSocket *socket, const QByteArray &request);
+  QByteArray withGeneration(QJsonObject object) const;
+};
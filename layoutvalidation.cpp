@@ -0,0 +1,238 @@
+#include "layoutvalidation.h"
+#include "modeline.h"
+
+namespace
+{
+  bool showsSamePicture(const LayoutOutput &a, const LayoutOutput &b)
+  {
+    return a.position == b.position && a.mode == b.mode
+        && a.orientation == b.orientation && a.reflection == b.reflection;
+  }
+
+  // Augmenting path step of Kuhn's bipartite matching of groups onto CRTCs.
+  bool assignCrtc(int group, const QList<QList<int>> &allowed, QHash<int, int> &owner, QSet<int> &visited)
+  {
+    for (int crtc : allowed.at(group))
+    {
+      if (visited.contains(crtc))
+        continue;
+      visited.insert(crtc);
+      auto it = owner.constFind(crtc);
+      if (it == owner.constEnd() || assignCrtc(it.value(), allowed, owner, visited))
+      {
+        owner.insert(crtc, group);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void checkScreenSize(const QList<LayoutOutput> &outputs, const LayoutConstraints &constraints,
+                       QList<LayoutIssue> &issues)
+  {
+    const QSize maximum = constraints.maximumScreenSize;
+    if (!maximum.isValid() || outputs.isEmpty())
+      return;
+    // A clone covers the area of its source, whatever its own mode.
+    QHash<QString, QSize> sizes;
+    for (const LayoutOutput &out : outputs)
+      sizes.insert(out.name, out.size());
+    QList<QRect> rects;
+    QRect bounds;
+    for (const LayoutOutput &out : outputs)
+    {
+      rects << QRect(out.position, sizes.value(out.cloneOf, out.size()));
+      bounds = bounds.united(rects.constLast());
+    }
+    for (int i = 0; i < outputs.size(); ++i)
+    {
+      // The X screen starts at the top-left output.
+      const QRect rect = rects.at(i).translated(-bounds.topLeft());
+      if (rect.x() + rect.width() > maximum.width() || rect.y() + rect.height() > maximum.height())
+      {
+        issues.append({i, QCoreApplication::translate("LayoutValidation", "Extends beyond the largest X screen the GPU supports (%1x%2).")
+                              .arg(maximum.width()).arg(maximum.height())});
+      }
+    }
+  }
+
+  void checkModeTimings(const QList<LayoutOutput> &outputs, const LayoutConstraints &constraints,
+                        QList<LayoutIssue> &issues)
+  {
+    for (int i = 0; i < outputs.size(); ++i)
+    {
+      const LayoutOutput &out = outputs.at(i);
+      if (!out.isCustomMode())
+        continue;
+      const XRandrTimingRange range = constraints.outputs.value(out.name).timingRange;
+      if (!range.valid)
+        continue;
+      // Custom modes are created with cvtModeline(), see XRandrBackend::modeCommands().
+      const Modeline mode = cvtModeline(out.mode.width(), out.mode.height());
+      if (range.maxPixelClockMHz > 0 && mode.clockMHz > range.maxPixelClockMHz)
+      {
+        issues.append({i, QCoreApplication::translate("LayoutValidation", "Mode %1x%2 needs a pixel clock of %3 MHz; the monitor accepts at most %4 MHz.")
+                              .arg(out.mode.width()).arg(out.mode.height())
+                              .arg(mode.clockMHz, 0, 'f', 2).arg(range.maxPixelClockMHz)});
+      }
+      const double hsync = mode.horizontalFrequencyKHz();
+      if (hsync < range.minHorizontalKHz || hsync > range.maxHorizontalKHz)
+      {
+        issues.append({i, QCoreApplication::translate("LayoutValidation", "Mode %1x%2 has a line rate of %3 kHz; the monitor accepts %4-%5 kHz.")
+                              .arg(out.mode.width()).arg(out.mode.height())
+                              .arg(hsync, 0, 'f', 1)
+                              .arg(range.minHorizontalKHz).arg(range.maxHorizontalKHz)});
+      }
+      const double refresh = mode.refreshRate();
+      if (refresh < range.minVerticalHz || refresh > range.maxVerticalHz)
+      {
+        issues.append({i, QCoreApplication::translate("LayoutValidation", "Mode %1x%2 refreshes at %3 Hz; the monitor accepts %4-%5 Hz.")
+                              .arg(out.mode.width()).arg(out.mode.height())
+                              .arg(refresh, 0, 'f', 1)
+                              .arg(range.minVerticalHz).arg(range.maxVerticalHz)});
+      }
+    }
+  }
+
+  void checkCrtcs(const QList<LayoutOutput> &outputs, const LayoutConstraints &constraints,
+                  QList<LayoutIssue> &issues)
+  {
+    if (constraints.crtcs.isEmpty())
+      return;
+
+    // Outputs that show the same picture and may be cloned share one CRTC,
+    // the way xrandr assigns them.
+    QList<QList<int>> groups;
+    QList<QList<int>> allowed;
+    for (int i = 0; i < outputs.size(); ++i)
+    {
+      const LayoutOutput &out = outputs.at(i);
+      const OutputConstraints oc = constraints.outputs.value(out.name);
+      QList<int> crtcs = oc.crtcs.isEmpty() ? constraints.crtcs : oc.crtcs;
+      bool grouped = false;
+      for (int g = 0; g < groups.size() && !grouped; ++g)
+      {
+        bool clonable = true;
+        for (int member : std::as_const(groups.at(g)))
+        {
+          const LayoutOutput &other = outputs.at(member);
+          clonable = clonable && showsSamePicture(out, other) && oc.clones.contains(other.name)
+                     && constraints.outputs.value(other.name).clones.contains(out.name);
+        }
+        QList<int> shared;
+        for (int crtc : std::as_const(allowed.at(g)))
+        {
+          if (crtcs.contains(crtc))
+            shared << crtc;
+        }
+        if (clonable && !shared.isEmpty())
+        {
+          groups[g] << i;
+          allowed[g] = shared;
+          grouped = true;
+        }
+      }
+      if (!grouped)
+      {
+        groups << QList<int>{i};
+        allowed << crtcs;
+      }
+    }
+
+    QHash<int, int> owner;
+    for (int g = 0; g < groups.size(); ++g)
+    {
+      QSet<int> visited;
+      if (assignCrtc(g, allowed, owner, visited))
+        continue;
+      for (int index : std::as_const(groups.at(g)))
+      {
+        const LayoutOutput &out = outputs.at(index);
+        QString message;
+        if (allowed.at(g).isEmpty())
+        {
+          message = QCoreApplication::translate("LayoutValidation", "No CRTC of the GPU can drive this output.");
+        }
+        else
+        {
+          message = QCoreApplication::translate("LayoutValidation", "No free CRTC: the GPU can show at most %1 different pictures at once.")
+                        .arg(constraints.crtcs.size());
+          for (int other = 0; other < outputs.size(); ++other)
+          {
+            if (other != index && showsSamePicture(out, outputs.at(other))
+            &&  !constraints.outputs.value(out.name).clones.contains(outputs.at(other).name))
+            {
+              message += ' ' + QCoreApplication::translate("LayoutValidation", "It cannot be cloned with %1.").arg(outputs.at(other).name);
+              break;
+            }
+          }
+        }
+        issues.append({index, message});
+      }
+    }
+  }
+}
+
+LayoutConstraints LayoutConstraints::fromBackend()
+{
+  XRandrBackend &xrandr = XRandrBackend::instance();
+  LayoutConstraints constraints;
+  constraints.maximumScreenSize = xrandr.screen().maximum;
+  const auto &monitors = xrandr.monitors();
+  QSet<int> crtcs;
+  for (auto it = monitors.constBegin(); it != monitors.constEnd(); ++it)
+  {
+    OutputConstraints oc;
+    oc.crtcs = it->crtcs;
+    oc.clones = it->clones;
+    oc.timingRange = it->timingRange;
+    constraints.outputs.insert(it.key(), oc);
+    for (int crtc : it->crtcs)
+      crtcs.insert(crtc);
+  }
+  constraints.crtcs = crtcs.values();
+  std::sort(constraints.crtcs.begin(), constraints.crtcs.end());
+  return constraints;
+}
+
+QList<LayoutIssue> validateLayout(const QList<LayoutOutput> &outputs, const LayoutConstraints &constraints)
+{
+  QList<LayoutIssue> issues;
+  checkScreenSize(outputs, constraints, issues);
+  checkModeTimings(outputs, constraints, issues);
+  // Every tile of a tiled display takes a CRTC of its own.
+  QList<LayoutOutput> units;
+  QList<int> owners;
+  for (int i = 0; i < outputs.size(); ++i)
+  {
+    const LayoutOutput &out = outputs.at(i);
+    if (!out.isTiled())
+    {
+      units << out;
+      owners << i;
+      continue;
+    }
+    for (const LayoutTile &tile : out.tiles)
+    {
+      LayoutOutput unit = out;
+      unit.name = tile.output;
+      unit.mode = tile.rect.size();
+      unit.position = out.position + out.tileRect(tile).topLeft();
+      unit.tiles.clear();
+      units << unit;
+      owners << i;
+    }
+  }
+  QList<LayoutIssue> crtcIssues;
+  checkCrtcs(units, constraints, crtcIssues);
+  for (LayoutIssue issue : std::as_const(crtcIssues))
+  {
+    issue.output = owners.at(issue.output);
+    bool duplicate = false;
+    for (const LayoutIssue &other : std::as_const(issues))
+      duplicate = duplicate || (other.output == issue.output && other.message == issue.message);
+    if (!duplicate)
+      issues << issue;
+  }
+  return issues;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QtCore>
+#include "layoutmodel.h"
+#include "xrandrbackend.h"
+
+struct LayoutIssue
+{
+  // Index of the affected output.
+  int output = -1;
+  QString message;
+};
+
+struct OutputConstraints
+{
+  // CRTCs that can drive the output; empty when unknown.
+  QList<int> crtcs;
+  // Outputs that can share a CRTC with this one.
+  QStringList clones;
+  XRandrTimingRange timingRange;
+};
+
+// Limits of the X server and the GPU a layout has to stay within. They are
+// taken once from the last RandR query, so validating a layout only does
+// arithmetic and can run on every drag event.
+struct LayoutConstraints
+{
+  // Largest X screen, see XRRGetScreenSizeRange(); invalid when unknown.
+  QSize maximumScreenSize;
+  // All CRTCs of the screen; empty when unknown.
+  QList<int> crtcs;
+  QHash<QString, OutputConstraints> outputs;
+
+  static LayoutConstraints fromBackend();
+};
+
+// Checks that the X server can set the layout in one modeset: the screen
+// fits into the maximum size, every output gets a CRTC it can use (outputs
+// showing the same picture may share one when RandR allows them to be
+// cloned; each tile of a tiled display needs one of its own), and custom
+// modes stay within the timing limits of the monitor's EDID. Returns one
+// issue per problem and affected output.
+QList<LayoutIssue> validateLayout(const QList<LayoutOutput> &outputs, const LayoutConstraints &constraints);
@@ -0,0 +1,108 @@
+#include "layoutview.h"
+#include <QtWidgets>
+
+LayoutView::LayoutView(QGraphicsScene *scene, QWidget *parent)
+:QGraphicsView(scene, parent)
+{
+  setFrameStyle(QFrame::NoFrame);
+  setRenderHint(QPainter::Antialiasing, false);
+  setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+  setResizeAnchor(QGraphicsView::AnchorViewCenter);
+  // Only the regions of items that actually changed are repainted.
+  setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+  setOptimizationFlags(QGraphicsView::DontSavePainterState | QGraphicsView::DontAdjustForAntialiasing);
+  setCacheMode(QGraphicsView::CacheBackground);
+  setDragMode(QGraphicsView::RubberBandDrag);
+
+  QAction *zoomInAction = new QAction(this);
+  zoomInAction->setShortcut(QKeySequence::ZoomIn);
+  connect(zoomInAction, &QAction::triggered, this, &LayoutView::zoomIn);
+  addAction(zoomInAction);
+  QAction *zoomOutAction = new QAction(this);
+  zoomOutAction->setShortcut(QKeySequence::ZoomOut);
+  connect(zoomOutAction, &QAction::triggered, this, &LayoutView::zoomOut);
+  addAction(zoomOutAction);
+}
+
+void LayoutView::fitToView()
+{
+  if (!scene())
+    return;
+  QRectF bounds = scene()->itemsBoundingRect();
+  if (bounds.isEmpty())
+    return;
+  const double margin = qMax(bounds.width(), bounds.height()) * 0.05;
+  bounds.adjust(-margin, -margin, margin, margin);
+  fitInView(bounds, Qt::KeepAspectRatio);
+}
+
+void LayoutView::zoomIn()
+{
+  zoomBy(kZoomStep);
+}
+
+void LayoutView::zoomOut()
+{
+  zoomBy(1.0 / kZoomStep);
+}
+
+void LayoutView::zoomBy(double factor)
+{
+  const double current = transform().m11();
+  const double target = qBound(kMinZoom, current * factor, kMaxZoom);
+  if (qFuzzyCompare(target, current))
+    return;
+  scale(target / current, target / current);
+}
+
+void LayoutView::wheelEvent(QWheelEvent *event)
+{
+  const int delta = event->angleDelta().y();
+  if (delta == 0)
+  {
+    QGraphicsView::wheelEvent(event);
+    return;
+  }
+  zoomBy(std::pow(kZoomStep, delta / 120.0));
+  event->accept();
+}
+
+void LayoutView::mousePressEvent(QMouseEvent *event)
+{
+  if (event->button() == Qt::MiddleButton)
+  {
+    m_panning = true;
+    m_panStart = event->position().toPoint();
+    viewport()->setCursor(Qt::ClosedHandCursor);
+    event->accept();
+    return;
+  }
+  QGraphicsView::mousePressEvent(event);
+}
+
+void LayoutView::mouseMoveEvent(QMouseEvent *event)
+{
+  if (m_panning)
+  {
+    const QPoint pos = event->position().toPoint();
+    const QPoint delta = pos - m_panStart;
+    m_panStart = pos;
+    horizontalScrollBar()->setValue(horizontalScrollBar()->value() - delta.x());
+    verticalScrollBar()->setValue(verticalScrollBar()->value() - delta.y());
+    event->accept();
+    return;
+  }
+  QGraphicsView::mouseMoveEvent(event);
+}
+
+void LayoutView::mouseReleaseEvent(QMouseEvent *event)
+{
+  if (m_panning && event->button() == Qt::MiddleButton)
+  {
+    m_panning = false;
+    viewport()->unsetCursor();
+    event->accept();
+    return;
+  }
+  QGraphicsView::mouseReleaseEvent(event);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QGraphicsView>
+
+// Graphics view for the monitor layout with zoom, pan and fit-to-view.
+class LayoutView : public QGraphicsView
+{
+  Q_OBJECT
+public:
+  explicit LayoutView(QGraphicsScene *scene, QWidget *parent = nullptr);
+
+public slots:
+  void fitToView();
+  void zoomIn();
+  void zoomOut();
+
+protected:
+  void wheelEvent(QWheelEvent *event) override;
+  void mousePressEvent(QMouseEvent *event) override;
+  void mouseMoveEvent(QMouseEvent *event) override;
+  void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+  static constexpr double kZoomStep = 1.25;
+  static constexpr double kMinZoom = 0.02;
+  static constexpr double kMaxZoom = 20.0;
+  bool m_panning = false;
+  QPoint m_panStart;
+
+  void zoomBy(double factor);
+};
@@ -0,0 +1,128 @@
+#include "livepreview.h"
+#include "applypipeline.h"
+#include "layoutvalidation.h"
+#include "rollback.h"
+#include "xrandrbackend.h"
+
+LivePreview::LivePreview(LayoutModel *model, Rollback *rollback, QObject *parent)
+:QObject(parent),
+m_model(model),
+m_rollback(rollback)
+{
+  m_pipeline = new ApplyPipeline(this);
+  connect(m_pipeline, &ApplyPipeline::finished, this, &LivePreview::onFinished);
+
+  m_debounce.setSingleShot(true);
+  m_debounce.setInterval(kDebounceDelay);
+  connect(&m_debounce, &QTimer::timeout, this, &LivePreview::applyNow);
+
+  connect(m_model, &LayoutModel::outputChanged, this, &LivePreview::scheduleApply);
+  connect(m_model, &LayoutModel::layoutChanged, this, &LivePreview::scheduleApply);
+}
+
+void LivePreview::setEnabled(bool enabled)
+{
+  if (m_enabled == enabled)
+    return;
+  m_enabled = enabled;
+  if (!m_enabled)
+  {
+    // A running countdown keeps going, so an unconfirmed layout is still reverted.
+    m_debounce.stop();
+    m_dirty = false;
+  }
+}
+
+bool LivePreview::isApplying() const
+{
+  return m_pipeline->isRunning();
+}
+
+void LivePreview::setBlocked(bool blocked)
+{
+  if (m_blocked == blocked)
+    return;
+  m_blocked = blocked;
+  if (m_blocked)
+  {
+    if (m_debounce.isActive())
+    {
+      m_debounce.stop();
+      m_dirty = true;
+    }
+  }
+  else if (m_dirty && !m_pipeline->isRunning())
+  {
+    m_debounce.start();
+  }
+}
+
+void LivePreview::scheduleApply()
+{
+  if (!m_enabled)
+    return;
+  if (m_pipeline->isRunning() || m_blocked)
+  {
+    m_dirty = true;
+    return;
+  }
+  m_debounce.start();
+}
+
+void LivePreview::applyNow()
+{
+  if (m_blocked)
+  {
+    m_dirty = true;
+    return;
+  }
+  m_dirty = false;
+  const XRandrBackend &xrandr = XRandrBackend::instance();
+  const QList<XRandrMonitorConfig> changed = xrandr.changedConfigs(m_model->xrandrConfigs());
+  if (changed.isEmpty())
+    return;
+  // A layout the server would reject only costs a blank screen; wait for a valid one.
+  if (!validateLayout(m_model->outputs(), LayoutConstraints::fromBackend()).isEmpty())
+  {
+    emit applyFailed(tr("The layout cannot be set, see the warnings on the monitors."));
+    return;
+  }
+  // The state to revert to is the one before the first unconfirmed change.
+  if (!m_rollback->isCountingDown() && !m_rollback->capture())
+  {
+    emit applyFailed(tr("Not applied: the current state could not be captured to revert to."));
+    return;
+  }
+
+  ApplyStage stage;
+  stage.name = tr("Live preview");
+  const QList<QStringList> modeCommands = xrandr.modeCommands(changed);
+  for (const QStringList &arguments : modeCommands)
+  {
+    ApplyCommand command;
+    command.program = "xrandr";
+    command.arguments = arguments;
+    command.allowFailure = (arguments.constFirst() == "--newmode");
+    stage.commands << command;
+  }
+  ApplyCommand outputsCommand;
+  outputsCommand.program = "xrandr";
+  outputsCommand.arguments = xrandr.outputArguments(changed);
+  stage.commands << outputsCommand;
+  // The pipeline reads the resulting state back, so the next diff is
+  // computed against what the server actually did.
+  m_pipeline->start({stage});
+}
+
+void LivePreview::onFinished(bool ok, const QString &message)
+{
+  if (!ok)
+    emit applyFailed(message);
+  // Every change restarts the countdown, also one that failed halfway,
+  // unless a restore already waits for this change to finish.
+  if (!m_rollback->isRunning())
+    m_rollback->startCountdown();
+
+  if (m_dirty && !m_blocked)
+    m_debounce.start();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QtCore>
+#include "layoutmodel.h"
+
+class ApplyPipeline;
+class Rollback;
+
+// Applies layout changes to the real outputs while they are being made.
+// Changes are debounced and coalesced: at most one reconfiguration runs at a
+// time and the newest layout is applied once it has finished. Before the
+// first change that is not yet confirmed the state is captured with
+// rollback, and every applied change restarts its countdown, in case the
+// operator can no longer see the screens. While an Apply or a rollback
+// runs, changes are only collected, so there is never more than one
+// reconfiguration in flight.
+class LivePreview : public QObject
+{
+  Q_OBJECT
+public:
+  LivePreview(LayoutModel *model, Rollback *rollback, QObject *parent = nullptr);
+
+  bool isEnabled() const { return m_enabled; }
+  void setEnabled(bool enabled);
+  ApplyPipeline *pipeline() const { return m_pipeline; }
+  bool isApplying() const;
+  // Holds back the changes while another pipeline reconfigures the outputs;
+  // the newest layout is applied once unblocked.
+  void setBlocked(bool blocked);
+
+signals:
+  void applyFailed(const QString &message);
+
+private:
+  static constexpr int kDebounceDelay = 50;
+
+  LayoutModel *m_model;
+  Rollback *m_rollback;
+  ApplyPipeline *m_pipeline = nullptr;
+  QTimer m_debounce;
+  bool m_enabled = false;
+  bool m_dirty = false;
+  bool m_blocked = false;
+
+  void scheduleApply();
+  void applyNow();
+  void onFinished(bool ok, const QString &message);
+};
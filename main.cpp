@@ -1,11 +1,59 @@
 #include <QtCore>
 #include <QtWidgets>
+#include "batchgenerator.h"
+#include "layoutservice.h"
 #include "mainwindow.h"
+#include "rollback.h"
+#include "tracer.h"
+#include "version.h"
 
 int main(int argc, char *argv[])
 {
-  QApplication app(argc, argv);
-  app.setWindowIcon(QIcon(":/assets/app_icon.svg"));
+  QElapsedTimer startupTimer;
+  startupTimer.start();
+  // Batch generation runs on build hosts without a display, where a
+  // QApplication could not connect to one.
+  bool batch = false;
+  for (int i = 1; i < argc; ++i)
+    batch = batch || qstrcmp(argv[i], "--batch") == 0 || qstrncmp(argv[i], "--batch=", 8) == 0;
+  QScopedPointer<QCoreApplication> app(batch ? new QCoreApplication(argc, argv) : new QApplication(argc, argv));
+  if (!batch)
+    QApplication::setWindowIcon(QIcon(":/assets/app_icon.svg"));
+  app->setApplicationVersion(APP_VERSION);
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  parser.addVersionOption();
+  QCommandLineOption traceOption("trace",
+                                 QCoreApplication::translate("main", "Write a Chrome/Perfetto trace of startup and apply phases to <file>."),
+                                 "file");
+  parser.addOption(traceOption);
+  QCommandLineOption daemonOption("daemon",
+                                  QCoreApplication::translate("main", "Run without a window and serve the current layout on a local socket."));
+  parser.addOption(daemonOption);
+  QCommandLineOption socketOption("socket",
+                                  QCoreApplication::translate("main", "Socket path for --daemon (default: %1).").arg(LayoutService::defaultSocketPath()),
+                                  "path", LayoutService::defaultSocketPath());
+  parser.addOption(socketOption);
+  QCommandLineOption rollbackOption("rollback",
+                                    QCoreApplication::translate("main", "Restore the state from before the last apply (%1) and exit.").arg(StateSnapshot::defaultPath()));
+  parser.addOption(rollbackOption);
+  QCommandLineOption batchOption("batch",
+                                 QCoreApplication::translate("main", "Write the scripts and configurations of all consoles in <manifest> and exit; needs no X server."),
+                                 "manifest");
+  parser.addOption(batchOption);
+  QCommandLineOption outputDirOption("output-dir",
+                                     QCoreApplication::translate("main", "Directory for --batch, one subdirectory per console (default: current directory)."),
+                                     "dir", ".");
+  parser.addOption(outputDirOption);
+  QCommandLineOption jobsOption("jobs",
+                                QCoreApplication::translate("main", "Consoles --batch generates in parallel (default: %1).").arg(QThread::idealThreadCount()),
+                                "n", QString::number(QThread::idealThreadCount()));
+  parser.addOption(jobsOption);
+  parser.process(*app);
+
+  if (parser.isSet(traceOption))
+    Tracer::instance().enable(parser.value(traceOption));
 
   const QString localeName = QLocale::system().name();
   const QString shortLang = localeName.section('_', 0, 0).toLower();
@@ -14,11 +62,64 @@ int main(int argc, char *argv[])
   QTranslator translator;
   if(translator.load(qmFilePath))
   {
-    app.installTranslator(&translator);
+    app->installTranslator(&translator);
   }
 
-  MainWindow w;
-  w.show();
+  int result = 0;
+  if (batch)
+  {
+    BatchGenerator generator;
+    if (!generator.loadManifest(parser.value(batchOption)))
+    {
+      qWarning().noquote() << "Cannot read manifest:" << generator.errorString();
+      return 1;
+    }
+    const BatchGenerator::Result batchResult = generator.run(parser.value(outputDirOption),
+                                                             parser.value(jobsOption).toInt());
+    const double perSecond = batchResult.consoles * 1000.0 / qMax<qint64>(1, batchResult.elapsedMs);
+    // The summary is the result of the run, so it goes to stdout, unlike the problems.
+    QTextStream out(stdout);
+    out << QString("Generated %1 of %2 consoles in %3 ms (%4 consoles/s).")
+               .arg(batchResult.consoles - batchResult.failed).arg(batchResult.consoles)
+               .arg(batchResult.elapsedMs).arg(perSecond, 0, 'f', 0)
+        << Qt::endl;
+    result = batchResult.failed > 0 ? 1 : 0;
+  }
+  else if (parser.isSet(rollbackOption))
+  {
+    Rollback rollback;
+    if (!rollback.load(StateSnapshot::defaultPath()))
+    {
+      qWarning() << "No snapshot found at" << StateSnapshot::defaultPath();
+      return 1;
+    }
+    QObject::connect(&rollback, &Rollback::finished, app.data(), [](bool ok, const QString &message)
+    {
+      if (ok)
+        QTextStream(stdout) << message << Qt::endl;
+      else
+        qWarning().noquote() << "Rollback failed:" << message;
+      QCoreApplication::exit(ok ? 0 : 1);
+    });
+    QTimer::singleShot(0, &rollback, &Rollback::rollback);
+    result = app->exec();
+  }
+  else if (parser.isSet(daemonOption))
+  {
+    QApplication::setQuitOnLastWindowClosed(false);
+    LayoutService service;
+    if (!service.listen(parser.value(socketOption)))
+      return 1;
+    result = app->exec();
+  }
+  else
+  {
+    MainWindow w(startupTimer);
+    w.show();
+    result = app->exec();
+  }
 
-  return app.exec();
+  if (Tracer::isEnabled())
+    Tracer::instance().writeFile();
+  return result;
 }
@@ -1,79 +1,210 @@
 #include "mainwindow.h"
 #include <QtCore>
 #include <QtWidgets>
+#include "applypipeline.h"
+#include "applyscript.h"
+#include "layoutgeometry.h"
+#include "layoutloader.h"
+#include "layoutmodel.h"
+#include "layoutview.h"
+#include "livepreview.h"
 #include "monitoritem.h"
+#include "rollback.h"
+#include "tracer.h"
 #include "xinputbackend.h"
 #include "xrandrbackend.h"
 #include "version.h"
 
-MainWindow::MainWindow(QWidget *parent)
-:QMainWindow(parent)
+MainWindow::MainWindow(const QElapsedTimer &startupTimer, QWidget *parent)
+:QMainWindow(parent),
+m_startupTimer(startupTimer)
 {
+  TraceScope constructScope("MainWindow::MainWindow");
   setWindowIcon(QIcon(":/assets/app_icon.svg"));
-  bool adjustViewSize = true;
-  const QStringList monitors = XRandrBackend::instance().connectedMonitorNames();
+  // The window is shown right away; the outputs are added while xrandr reports them.
+  m_model = new LayoutModel(this);
+  m_loader = new LayoutLoader(m_model, this);
 
-  if(monitors.isEmpty())
-  {
-    adjustViewSize = false;
-    this->resize(640, 480);
-    QMessageBox::critical(this, tr("Error"),
-                          tr("No monitor information detected via xrandr.\nPlease ensure that xrandr is correctly installed and available in your PATH."));
-  }
+  m_rollback = new Rollback(this);
+  m_livePreview = new LivePreview(m_model, m_rollback, this);
 
   m_scene = new QGraphicsScene(this);
-  m_view = new QGraphicsView(m_scene, this);
-  m_view->setAlignment(Qt::AlignLeft | Qt::AlignTop);
-  m_view->setFrameStyle(QFrame::NoFrame);
+  m_view = new LayoutView(m_scene, this);
+  m_view->viewport()->installEventFilter(this);
   setCentralWidget(m_view);
+  m_placeholder = m_scene->addSimpleText(tr("Detecting monitors..."));
+  m_placeholder->setBrush(palette().color(QPalette::PlaceholderText));
   createToolbar();
+  // Applying a partially loaded layout would switch off the missing outputs.
+  m_toolbar->setEnabled(false);
+  m_applyProgress = new QProgressBar(this);
+  m_applyProgress->setMaximumWidth(160);
+  m_applyProgress->setVisible(false);
+  statusBar()->addPermanentWidget(m_applyProgress);
+  m_revertControls = new QWidget(this);
+  QHBoxLayout *revertLayout = new QHBoxLayout(m_revertControls);
+  revertLayout->setContentsMargins(0, 0, 0, 0);
+  m_revertLabel = new QLabel(m_revertControls);
+  QPushButton *keepButton = new QPushButton(tr("Keep"), m_revertControls);
+  QPushButton *revertButton = new QPushButton(tr("Revert"), m_revertControls);
+  revertLayout->addWidget(m_revertLabel);
+  revertLayout->addWidget(keepButton);
+  revertLayout->addWidget(revertButton);
+  m_revertControls->setVisible(false);
+  statusBar()->addPermanentWidget(m_revertControls);
+  // Apply and the live preview both revert to the snapshot of the rollback.
+  connect(keepButton, &QPushButton::clicked, m_rollback, &Rollback::confirm);
+  connect(revertButton, &QPushButton::clicked, m_rollback, &Rollback::rollback);
+  connect(m_rollback, &Rollback::countdown, this, [this](int secondsLeft)
+  {
+    m_revertLabel->setText(tr("Reverting in %n second(s)", "", secondsLeft));
+    m_revertControls->setVisible(true);
+  });
+  connect(m_rollback, &Rollback::countdownStopped, m_revertControls, &QWidget::hide);
+  connect(m_rollback, &Rollback::finished, this, &MainWindow::rollbackFinished);
+  // One reconfiguration at a time: the live preview holds its changes
+  // while an Apply or a rollback runs, and a rollback waits for both.
+  m_rollback->waitFor(m_livePreview->pipeline());
+  connect(m_rollback, &Rollback::restoring, this, [this]()
+  {
+    m_livePreview->setBlocked(true);
+  });
+  connect(m_livePreview, &LivePreview::applyFailed, this, [this](const QString &message)
+  {
+    statusBar()->showMessage(tr("Live preview failed: %1").arg(message), 10000);
+  });
+  m_layoutStatus = new QLabel(this);
+  statusBar()->addPermanentWidget(m_layoutStatus);
+
+  m_applyPipeline = new ApplyPipeline(this);
+  connect(m_applyPipeline, &ApplyPipeline::stageStarted, this, [this](int index, int count, const QString &name)
+  {
+    statusBar()->showMessage(tr("Applying: %1 (%2/%3)...").arg(name).arg(index + 1).arg(count));
+  });
+  connect(m_applyPipeline, &ApplyPipeline::stageFinished, this, [this](int index, int, const QString &name, qint64 msecs)
+  {
+    m_applyProgress->setValue(index + 1);
+    m_stageTimings << tr("%1 %2 ms").arg(name).arg(msecs);
+  });
+  connect(m_applyPipeline, &ApplyPipeline::finished, this, &MainWindow::applyFinished);
+  m_rollback->waitFor(m_applyPipeline);
+
+  connect(m_model, &LayoutModel::outputAdded, this, &MainWindow::outputAdded);
+  connect(m_model, &LayoutModel::outputChanged, this, &MainWindow::outputChanged);
+  connect(m_model, &LayoutModel::layoutChanged, this, &MainWindow::layoutChanged);
+  connect(m_loader, &LayoutLoader::outputsLoaded, this, &MainWindow::outputsLoaded);
+  connect(m_loader, &LayoutLoader::finished, this, &MainWindow::loadingFinished);
+  connect(m_loader, &LayoutLoader::failed, this, &MainWindow::loadingFailed);
+  updateLayoutStatus();
+
+  QScreen *primaryScreen = QGuiApplication::primaryScreen();
+  if (primaryScreen)
+  {
+    QRect primaryGeom = primaryScreen->availableGeometry();
+    resize(primaryGeom.size() * 0.6);
+    int x = primaryGeom.x() + (primaryGeom.width() - width()) / 2;
+    int y = primaryGeom.y() + (primaryGeom.height() - height()) / 2;
+    move(x, y);
+  }
+  else
+  {
+    resize(640, 480);
+  }
+  m_loader->start();
+}
 
-  for(const QString &monName : monitors)
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+  if (event->type() == QEvent::Paint && watched == m_view->viewport())
   {
-    MonitorItem *itm = new MonitorItem(monName);
-    m_scene->addItem(itm);
+    m_view->viewport()->removeEventFilter(this);
+    recordStartupMetric("first paint");
   }
+  return QMainWindow::eventFilter(watched, event);
+}
 
-  if(adjustViewSize)
+void MainWindow::recordStartupMetric(const char *name)
+{
+  const qint64 elapsedUs = m_startupTimer.nsecsElapsed() / 1000;
+  m_startupMetrics << qMakePair(QByteArray(name), elapsedUs);
+  if (Tracer::isEnabled())
   {
-    QTimer::singleShot(0, this, [this]()
-    {
-      this->adjustSize();
-      QRectF bounding = m_scene->itemsBoundingRect();
-      QSize desiredViewSize(int(bounding.width() * 2), int(bounding.height() * 2));
-      QSize extra = size() - m_view->size();
-      QSize newSize = desiredViewSize + extra;
-      resize(newSize);
+    // One event per milestone, starting when the process started.
+    Tracer &tracer = Tracer::instance();
+    TraceEvent event;
+    event.name = QByteArray("time to ") + name;
+    event.category = "startup";
+    event.durationUs = elapsedUs;
+    event.startUs = qMax<qint64>(0, tracer.nowUs() - elapsedUs);
+    tracer.addEvent(std::move(event));
+  }
+}
 
-      QScreen *primaryScreen = QGuiApplication::primaryScreen();
-      if (primaryScreen)
-      {
-        QRect primaryGeom = primaryScreen->availableGeometry();
-        int x = primaryGeom.x() + (primaryGeom.width() - width()) / 2;
-        int y = primaryGeom.y() + (primaryGeom.height() - height()) / 2;
-        move(x, y);
-      }
-    });
+void MainWindow::writeStartupMetrics() const
+{
+  // Next to the metrics of the apply script, which replaces its own file.
+  QString metricsFile = qEnvironmentVariable("DPSET_METRICS_FILE");
+  if (metricsFile.isEmpty())
+    metricsFile = qEnvironmentVariable("XDG_RUNTIME_DIR", "/tmp") + "/dpset.prom";
+  const QString path = QFileInfo(metricsFile).absolutePath() + "/dpset-startup.prom";
+
+  QByteArray text;
+  text += "# HELP dpset_startup_seconds Time from the start of dpset to each startup milestone.\n";
+  text += "# TYPE dpset_startup_seconds gauge\n";
+  for (const auto &[name, elapsedUs] : m_startupMetrics)
+  {
+    text += "dpset_startup_seconds{milestone=\"" + QByteArray(name).replace(' ', '_') + "\"} "
+          + QByteArray::number(elapsedUs / 1e6, 'f', 6) + '\n';
   }
+  // Renamed into place, so the collector never reads a partial file.
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit())
+    qWarning() << "Cannot write the startup metrics to" << path;
 }
 
 void MainWindow::createToolbar()
 {
   QToolBar *toolbar = addToolBar("Main Toolbar");
+  m_toolbar = toolbar;
   toolbar->setMovable(false);
   toolbar->setFloatable(false);
   toolbar->setToolButtonStyle(Qt::ToolButtonTextUnderIcon);
 
-  QAction *applyAction = new QAction(QIcon(":/assets/data_check.svg"), tr("Apply"), this);
+  m_applyAction = new QAction(QIcon(":/assets/data_check.svg"), tr("Apply"), this);
   QAction *scriptAction = new QAction(QIcon(":/assets/data_object.svg"), tr("Script"), this);
+  QAction *exportAction = new QAction(QIcon(":/assets/file_export.svg"), tr("Export"), this);
+  QMenu *exportMenu = new QMenu(this);
+  QAction *xorgAction = exportMenu->addAction(tr("Xorg configuration..."));
+  QAction *udevAction = exportMenu->addAction(tr("udev touch rules..."));
+  QAction *evdevAction = exportMenu->addAction(tr("evdev touch configuration..."));
+  exportAction->setMenu(exportMenu);
+  QAction *liveAction = new QAction(QIcon(":/assets/visibility.svg"), tr("Live"), this);
+  liveAction->setCheckable(true);
+  liveAction->setToolTip(tr("Apply moves, rotations and mode changes to the screens immediately"));
+  QAction *fitAction = new QAction(QIcon(":/assets/fit_screen.svg"), tr("Fit"), this);
+  fitAction->setToolTip(tr("Zoom to show all monitors (zoom with the mouse wheel, pan with the middle button)"));
+  QAction *compactAction = new QAction(QIcon(":/assets/compress.svg"), tr("Compact"), this);
+  compactAction->setToolTip(tr("Remove gaps and overlaps between monitors to minimize the framebuffer"));
   QAction *infoAction = new QAction(QIcon(":/assets/info.svg"), tr("Info"), this);
 
-  connect(applyAction, &QAction::triggered, this, &MainWindow::applyConfig);
+  connect(m_applyAction, &QAction::triggered, this, &MainWindow::applyConfig);
   connect(scriptAction, &QAction::triggered, this, &MainWindow::saveScript);
+  connect(xorgAction, &QAction::triggered, this, &MainWindow::exportXorgConfig);
+  connect(udevAction, &QAction::triggered, this, &MainWindow::exportUdevRules);
+  connect(evdevAction, &QAction::triggered, this, &MainWindow::exportEvdevConfig);
+  connect(liveAction, &QAction::toggled, m_livePreview, &LivePreview::setEnabled);
+  connect(fitAction, &QAction::triggered, m_view, &LayoutView::fitToView);
+  connect(compactAction, &QAction::triggered, this, &MainWindow::autoCompact);
   connect(infoAction, &QAction::triggered, this, &MainWindow::showInfo);
 
-  toolbar->addAction(applyAction);
+  toolbar->addAction(m_applyAction);
+  toolbar->addAction(liveAction);
   toolbar->addAction(scriptAction);
+  toolbar->addAction(exportAction);
+  if (QToolButton *exportButton = qobject_cast<QToolButton *>(toolbar->widgetForAction(exportAction)))
+    exportButton->setPopupMode(QToolButton::InstantPopup);
+  toolbar->addAction(fitAction);
+  toolbar->addAction(compactAction);
   toolbar->addAction(infoAction);
 }
 
@@ -84,10 +215,13 @@ void MainWindow::showInfo()
                          "Right-click on a monitor to access its context menu. From there, you can:\n"
                          "  - Use 'Identify' to display the physical monitor name on the corresponding screen.\n"
                          "  - Mark a monitor as primary.\n"
-                         "  - Change the resolution and orientation.\n\n"
-                         "You can drag and drop the monitor items to reposition them.\n\n"
+                         "  - Change the resolution and orientation. Rotations marked as emulated are not done by the graphics hardware and cost CPU time.\n\n"
+                         "You can drag and drop the monitor items to reposition them. Select several monitors to move, align or rotate them as a group.\n"
+                         "Zoom with the mouse wheel, pan with the middle mouse button and use Fit to show all monitors.\n"
+                         "Use the Compact button to remove gaps and overlaps, which keeps the framebuffer as small as possible.\n\n"
                          "Note that the xrandr configuration applied is not persistent – it will be lost after a reboot.\n\n"
                          "Use the Apply button to immediately apply the current configuration.\n"
+                         "After Apply, and with Live enabled while you make changes, press Keep within 15 seconds, otherwise the previous layout is restored.\n"
                          "Use the Script button to create a startup script that you must run after each boot."
       );
 
@@ -103,88 +237,312 @@ QMenu *MainWindow::createPopupMenu()
   return nullptr;
 }
 
+bool MainWindow::confirmIssues(const QString &title)
+{
+  if (m_issues.isEmpty())
+    return true;
+  QStringList lines;
+  for (const LayoutIssue &issue : std::as_const(m_issues))
+    lines << m_model->output(issue.output).name + ": " + issue.message;
+  QMessageBox::StandardButton answer = QMessageBox::warning(
+      this, title,
+      tr("The X server is likely to reject this layout:\n\n%1\n\nContinue anyway?").arg(lines.join('\n')),
+      QMessageBox::Yes | QMessageBox::Cancel, QMessageBox::Cancel);
+  return answer == QMessageBox::Yes;
+}
+
 QString MainWindow::buildScript()
 {
-  QList<XRandrMonitorConfig> xrandrConfigs;
-  QList<XInputDeviceConfig> xinputConfigs;
+  TraceScope scope("MainWindow::buildScript");
+  return buildApplyScript(m_model->xrandrConfigs(), m_model->xinputConfigs());
+}
+
+void MainWindow::applyConfig()
+{
+  if (m_applyPipeline->isRunning() || m_rollback->isRunning())
+    return;
+  if (m_livePreview->isApplying())
+  {
+    statusBar()->showMessage(tr("The live preview is still being applied; try again in a moment."), 5000);
+    return;
+  }
 
-  for(QGraphicsItem *item : m_scene->items())
+  const QList<XRandrMonitorConfig> xrandrConfigs = m_model->xrandrConfigs();
+  if (xrandrConfigs.isEmpty())
   {
-    MonitorItem *monItem = dynamic_cast<MonitorItem *>(item);
-    if (!monItem)
-      continue;
+    qWarning() << "No valid config found.";
+    return;
+  }
+  if (!confirmIssues(tr("Apply")))
+    return;
+
+  m_livePreview->setBlocked(true);
+  if (!m_rollback->capture())
+    qWarning() << "Could not capture the current state; the apply cannot be rolled back.";
+  const QList<ApplyStage> stages = ApplyPipeline::layoutStages(xrandrConfigs, m_model->xinputConfigs());
+  m_stageTimings.clear();
+  m_applyAction->setEnabled(false);
+  m_applyProgress->setRange(0, stages.size());
+  m_applyProgress->setValue(0);
+  m_applyProgress->setVisible(true);
+  m_applyPipeline->start(stages);
+}
 
-    XRandrMonitorConfig xrandrCfg;
-    xrandrCfg.screenName = monItem->screenName();
-    xrandrCfg.resolution = monItem->currentResolution();
-    QPointF pos = monItem->pos();
-    xrandrCfg.position = QPoint(qRound(pos.x() / monItem->scaleFactor()),
-                                qRound(pos.y() / monItem->scaleFactor()));
-    xrandrCfg.orientation = orientationToString(monItem->orientation());
-    xrandrCfg.isPrimary = monItem->isPrimary();
-    xrandrConfigs.append(xrandrCfg);
-
-    XInputDeviceConfig xinputCfg;
-    QRect monitorRect = monItem->sceneBoundingRect().toRect();
-    if (monItem->orientation() == Orientation::Left
-    ||  monItem->orientation() == Orientation::Right)
+void MainWindow::applyFinished(bool ok, const QString &message)
+{
+  m_applyAction->setEnabled(true);
+  m_applyProgress->setVisible(false);
+  if (!ok)
+  {
+    statusBar()->clearMessage();
+    if (!m_rollback->snapshot().isValid())
     {
-      monitorRect.setSize(monitorRect.size().transposed());
+      m_livePreview->setBlocked(false);
+      QMessageBox::warning(this, tr("Apply failed"), message);
+      return;
     }
-    QSize totalSize(m_scene->itemsBoundingRect().width(), m_scene->itemsBoundingRect().height());
-    xinputCfg.idPath = monItem->touchDeviceIdPath();
-    xinputCfg.deviceName = monItem->touchDeviceName();
-    xinputCfg.outputName = monItem->screenName();
-    xinputCfg.orientation = monItem->orientation();
-    xinputCfg.totalSize = totalSize;
-    xinputCfg.monitorRect = monitorRect;
-    xinputConfigs.append(xinputCfg);
+    // Do not leave the outputs half configured.
+    m_rollback->rollback();
+    QMessageBox::warning(this, tr("Apply failed"), tr("%1\n\nThe previous layout is restored.").arg(message));
+    return;
   }
 
-  QString script = "#!/bin/bash\n\n";
-  script += XRandrBackend::instance().buildScript(xrandrConfigs);
-  script += "\n\n";
-  script += XInputBackend::instance().buildScript(xinputConfigs);
-  return script;
+  m_model->updateFromBackend();
+  m_constraints = LayoutConstraints::fromBackend();
+  updateLayoutStatus();
+  m_livePreview->setBlocked(false);
+  m_rollback->startCountdown();
+  statusBar()->showMessage(message + " (" + m_stageTimings.join(", ") + ")", 10000);
 }
 
-void MainWindow::applyConfig()
+void MainWindow::rollbackFinished(bool ok, const QString &message)
 {
-  QString script = buildScript();
-  if(script.isEmpty())
-  {
-    qWarning() << "No valid config found.";
-  }
-  else
+  if (!ok)
   {
-    QProcess::startDetached("/bin/sh", QStringList() << "-c" << script);
+    m_livePreview->setBlocked(false);
+    QMessageBox::warning(this, tr("Rollback failed"), message);
+    return;
   }
+  // Changes made while restoring are dropped with the restored layout.
+  m_model->updateFromBackend();
+  m_constraints = LayoutConstraints::fromBackend();
+  updateLayoutStatus();
+  m_livePreview->setBlocked(false);
+  statusBar()->showMessage(message, 10000);
 }
 
 void MainWindow::saveScript()
 {
+  if (!confirmIssues(tr("Save Script")))
+    return;
   QString script = buildScript();
-  QString defaultFileName = QDir::homePath() + "/monitor_setup.sh";
-  QString filename = QFileDialog::getSaveFileName(this,
-                                                  tr("Save Script"),
-                                                  defaultFileName,
-                                                  tr("Shell Script (*.sh);;All Files (*)"));
+  QString filename = writeTextFile(tr("Save Script"),
+                                   QDir::homePath() + "/monitor_setup.sh",
+                                   tr("Shell Script (*.sh);;All Files (*)"),
+                                   script);
   if (filename.isEmpty())
     return;
 
+  QFile file(filename);
+  QFile::Permissions perms = file.permissions();
+  perms |= QFile::ExeOwner;
+  file.setPermissions(perms);
+
+  qDebug() << "Script saved at" << filename << "with +x";
+}
+
+QString MainWindow::writeTextFile(const QString &title, const QString &defaultFileName,
+                                  const QString &filter, const QString &text)
+{
+  QString filename = QFileDialog::getSaveFileName(this, title, defaultFileName, filter);
+  if (filename.isEmpty())
+    return QString();
+
   QFile file(filename);
   if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
   {
     qWarning() << "Cannot open file for writing:" << filename;
-    return;
+    return QString();
   }
   QTextStream ts(&file);
-  ts << script;
+  ts << text;
   file.close();
+  return filename;
+}
 
-  QFile::Permissions perms = file.permissions();
-  perms |= QFile::ExeOwner;
-  file.setPermissions(perms);
+void MainWindow::exportXorgConfig()
+{
+  const QList<XRandrMonitorConfig> xrandrConfigs = m_model->xrandrConfigs();
 
-  qDebug() << "Script saved at" << filename << "with +x";
+  const XRandrBackend &xrandr = XRandrBackend::instance();
+  const QString config = xrandr.buildXorgConfig(xrandrConfigs);
+  const QStringList problems = xrandr.validateXorgConfig(config, xrandrConfigs);
+  if (!problems.isEmpty())
+  {
+    QMessageBox::StandardButton answer = QMessageBox::warning(
+        this, tr("Xorg configuration"),
+        tr("The generated configuration does not reproduce the current layout:\n\n%1\n\nSave it anyway?")
+            .arg(problems.join('\n')),
+        QMessageBox::Save | QMessageBox::Cancel, QMessageBox::Cancel);
+    if (answer != QMessageBox::Save)
+      return;
+  }
+
+  QString filename = writeTextFile(tr("Export Xorg Configuration"),
+                                   QDir::homePath() + "/90-dpset-monitors.conf",
+                                   tr("Xorg Configuration (*.conf);;All Files (*)"),
+                                   config);
+  if (!filename.isEmpty())
+    qDebug() << "Xorg configuration saved at" << filename;
+}
+
+void MainWindow::exportUdevRules()
+{
+  QString filename = writeTextFile(tr("Export udev Touch Rules"),
+                                   QDir::homePath() + "/70-dpset-touch.rules",
+                                   tr("udev Rules (*.rules);;All Files (*)"),
+                                   XInputBackend::instance().buildUdevRules(m_model->xinputConfigs()));
+  if (!filename.isEmpty())
+    qDebug() << "udev rules saved at" << filename;
+}
+
+void MainWindow::exportEvdevConfig()
+{
+  QString filename = writeTextFile(tr("Export evdev Touch Configuration"),
+                                   QDir::homePath() + "/90-dpset-touch.conf",
+                                   tr("Xorg Configuration (*.conf);;All Files (*)"),
+                                   XInputBackend::instance().buildEvdevConfig(m_model->xinputConfigs()));
+  if (!filename.isEmpty())
+    qDebug() << "evdev touch configuration saved at" << filename;
+}
+
+void MainWindow::autoCompact()
+{
+  // Clones follow their sources, so only the sources are arranged.
+  QList<int> indices;
+  QList<QRect> rects;
+  for (int i = 0; i < m_model->count(); ++i)
+  {
+    if (m_model->output(i).isClone())
+      continue;
+    indices << i;
+    rects << m_model->rect(i);
+  }
+  m_model->setPositions(indices, compactLayout(rects));
+}
+
+void MainWindow::outputAdded(int index)
+{
+  if (m_items.isEmpty())
+  {
+    recordStartupMetric("first output");
+    delete m_placeholder;
+    m_placeholder = nullptr;
+  }
+  MonitorItem *item = new MonitorItem(m_model, index);
+  m_scene->addItem(item);
+  m_items.append(item);
+  updateLayoutStatus();
+  m_view->fitToView();
+}
+
+void MainWindow::outputsLoaded()
+{
+  recordStartupMetric("all outputs");
+  if (m_model->count() == 0)
+  {
+    m_placeholder->setText(tr("No monitors detected."));
+    QMessageBox::critical(this, tr("Error"),
+                          tr("No monitor information detected via xrandr.\nPlease ensure that xrandr is correctly installed and available in your PATH."));
+    return;
+  }
+  m_constraints = LayoutConstraints::fromBackend();
+  updateLayoutStatus();
+  m_toolbar->setEnabled(true);
+}
+
+void MainWindow::loadingFinished()
+{
+  recordStartupMetric("touch devices");
+  writeStartupMetrics();
+}
+
+void MainWindow::loadingFailed(const QString &message)
+{
+  // The outputs read so far may be incomplete, so nothing can be applied.
+  if (m_placeholder)
+    m_placeholder->setText(tr("Monitors could not be detected."));
+  QMessageBox::critical(this, tr("Error"),
+                        tr("Reading the monitor configuration with xrandr failed.\n%1").arg(message));
+}
+
+void MainWindow::outputChanged(int index)
+{
+  m_items.at(index)->syncFromModel();
+  updateLayoutStatus();
+}
+
+void MainWindow::layoutChanged()
+{
+  for (MonitorItem *item : std::as_const(m_items))
+    item->syncFromModel();
+  updateLayoutStatus();
+}
+
+void MainWindow::updateLayoutStatus()
+{
+  QList<QRect> rects = m_model->rects();
+  QSet<int> overlapping;
+  const QList<QPair<int, int>> overlaps = findOverlaps(rects);
+  for (const auto &pair : overlaps)
+  {
+    // A clone is meant to cover the picture of its source.
+    if (m_model->cloneSource(pair.first) == m_model->cloneSource(pair.second))
+      continue;
+    overlapping.insert(pair.first);
+    overlapping.insert(pair.second);
+  }
+  for (int i = 0; i < m_items.size(); ++i)
+    m_items.at(i)->setOverlapping(overlapping.contains(i));
+
+  m_issues = validateLayout(m_model->outputs(), m_constraints);
+  QList<QStringList> issuesPerOutput(m_items.size());
+  for (const LayoutIssue &issue : std::as_const(m_issues))
+  {
+    if (issue.output < issuesPerOutput.size())
+      issuesPerOutput[issue.output] << issue.message;
+  }
+  for (int i = 0; i < m_items.size(); ++i)
+    m_items.at(i)->setIssues(issuesPerOutput.at(i));
+
+  // The X screen always starts at 0,0, so measure from the top-left output.
+  const QPoint origin = m_model->bounds().topLeft();
+  for (QRect &r : rects)
+    r.translate(-origin);
+  const QSize fbSize = framebufferSize(rects);
+
+  QString text = tr("Framebuffer: %1x%2 (%3)")
+                     .arg(fbSize.width())
+                     .arg(fbSize.height())
+                     .arg(locale().formattedDataSize(framebufferBytes(fbSize)));
+  if (!overlapping.isEmpty())
+    text += " - " + tr("%n overlapping monitor(s)", "", overlapping.size());
+  int emulated = 0;
+  int clones = 0;
+  int tiled = 0;
+  for (const LayoutOutput &out : m_model->outputs())
+  {
+    emulated += out.isRotationEmulated() ? 1 : 0;
+    clones += out.isClone() ? 1 : 0;
+    tiled += out.isTiled() ? 1 : 0;
+  }
+  if (clones > 0)
+    text += " - " + tr("%n mirrored monitor(s)", "", clones);
+  if (tiled > 0)
+    text += " - " + tr("%n tiled display(s)", "", tiled);
+  if (emulated > 0)
+    text += " - " + tr("%n emulated rotation(s)", "", emulated);
+  if (!m_issues.isEmpty())
+    text += " - " + tr("%n problem(s)", "", m_issues.size());
+  m_layoutStatus->setText(text);
 }
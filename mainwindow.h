@@ -1,28 +1,81 @@
 #pragma once
 
+#include <QElapsedTimer>
 #include <QMainWindow>
+#include "layoutvalidation.h"
 
 class QGraphicsScene;
-class QGraphicsView;
+class QGraphicsSimpleTextItem;
+class QLabel;
+class QProgressBar;
+class ApplyPipeline;
+class LayoutLoader;
+class LayoutModel;
+class LayoutView;
+class LivePreview;
+class MonitorItem;
+class Rollback;
 
 class MainWindow : public QMainWindow
 {
   Q_OBJECT
 public:
-  explicit MainWindow(QWidget *parent = nullptr);
+  // startupTimer runs since the process started and times the first paint.
+  explicit MainWindow(const QElapsedTimer &startupTimer, QWidget *parent = nullptr);
   ~MainWindow() override = default;
 
+protected:
+  bool eventFilter(QObject *watched, QEvent *event) override;
+
 private:
+  LayoutModel *m_model = nullptr;
+  LayoutLoader *m_loader = nullptr;
+  QGraphicsSimpleTextItem *m_placeholder = nullptr;
+  QToolBar *m_toolbar = nullptr;
+  QElapsedTimer m_startupTimer;
+  // Startup milestones with their time since the process started, in µs.
+  QList<QPair<QByteArray, qint64>> m_startupMetrics;
+  QList<MonitorItem *> m_items;
   QGraphicsScene *m_scene = nullptr;
-  QGraphicsView *m_view = nullptr;
+  LayoutView *m_view = nullptr;
+  QLabel *m_layoutStatus = nullptr;
+  QAction *m_applyAction = nullptr;
+  QProgressBar *m_applyProgress = nullptr;
+  LivePreview *m_livePreview = nullptr;
+  Rollback *m_rollback = nullptr;
+  QLabel *m_revertLabel = nullptr;
+  QWidget *m_revertControls = nullptr;
+  ApplyPipeline *m_applyPipeline = nullptr;
+  QStringList m_stageTimings;
+  LayoutConstraints m_constraints;
+  QList<LayoutIssue> m_issues;
 
   void createToolbar();
+  void recordStartupMetric(const char *name);
+  void writeStartupMetrics() const;
   virtual QMenu *createPopupMenu() override;
 
+  // Asks whether to go on when the layout has validation problems.
+  bool confirmIssues(const QString &title);
   QString buildScript();
+  QString writeTextFile(const QString &title, const QString &defaultFileName,
+                        const QString &filter, const QString &text);
 
 private slots:
   void applyConfig();
   void saveScript();
+  void exportXorgConfig();
+  void exportUdevRules();
+  void exportEvdevConfig();
+  void autoCompact();
+  void outputAdded(int index);
+  void outputsLoaded();
+  void loadingFinished();
+  void loadingFailed(const QString &message);
+  void outputChanged(int index);
+  void layoutChanged();
+  void updateLayoutStatus();
+  void applyFinished(bool ok, const QString &message);
+  void rollbackFinished(bool ok, const QString &message);
   void showInfo();
 };
@@ -0,0 +1,106 @@
+#include "modeline.h"
+
+namespace
+{
+  constexpr int CVT_H_GRANULARITY = 8;
+  constexpr int CVT_MIN_V_PORCH = 3;
+  constexpr int CVT_MIN_V_BPORCH = 6;
+  constexpr int CVT_CLOCK_STEP = 250;
+  constexpr double CVT_MIN_VSYNC_BP = 550.0;
+  constexpr int CVT_HSYNC_PERCENTAGE = 8;
+  constexpr int CVT_M_PRIME = 600 * 128 / 256;
+  constexpr int CVT_C_PRIME = (40 - 20) * 128 / 256 + 20;
+  constexpr double CVT_RB_MIN_VBLANK = 460.0;
+  constexpr int CVT_RB_H_SYNC = 32;
+  constexpr int CVT_RB_H_BLANK = 160;
+  constexpr int CVT_RB_VFPORCH = 3;
+
+  int cvtVSyncWidth(int hDisplay, int vDisplay)
+  {
+    if (!(vDisplay % 3) && ((vDisplay * 4 / 3) == hDisplay))
+      return 4;
+    if (!(vDisplay % 9) && ((vDisplay * 16 / 9) == hDisplay))
+      return 5;
+    if (!(vDisplay % 10) && ((vDisplay * 16 / 10) == hDisplay))
+      return 6;
+    if (!(vDisplay % 4) && ((vDisplay * 5 / 4) == hDisplay))
+      return 7;
+    if (!(vDisplay % 9) && ((vDisplay * 15 / 9) == hDisplay))
+      return 7;
+    return 10;
+  }
+}
+
+QStringList Modeline::timingArguments() const
+{
+  QStringList args;
+  args << QString::number(clockMHz, 'f', 2)
+       << QString::number(hDisplay) << QString::number(hSyncStart)
+       << QString::number(hSyncEnd) << QString::number(hTotal)
+       << QString::number(vDisplay) << QString::number(vSyncStart)
+       << QString::number(vSyncEnd) << QString::number(vTotal)
+       << (hSyncPositive ? "+hsync" : "-hsync")
+       << (vSyncPositive ? "+vsync" : "-vsync");
+  return args;
+}
+
+// Port of xf86CVTMode() from the X server (no margins, not interlaced), using
+// the same single precision arithmetic so the results match cvt(1) exactly.
+Modeline cvtModeline(int width, int height, double refresh, bool reducedBlanking)
+{
+  Modeline mode;
+  const float vFieldRate = float(refresh);
+  mode.hDisplay = width - (width % CVT_H_GRANULARITY);
+  mode.vDisplay = height;
+  const int vSync = cvtVSyncWidth(mode.hDisplay, mode.vDisplay);
+  float hPeriod;
+
+  if (!reducedBlanking)
+  {
+    hPeriod = float(1000000.0 / vFieldRate - CVT_MIN_VSYNC_BP) / (mode.vDisplay + CVT_MIN_V_PORCH);
+    int vSyncAndBackPorch = int(CVT_MIN_VSYNC_BP / hPeriod + 1);
+    if (vSyncAndBackPorch < vSync + CVT_MIN_V_PORCH)
+      vSyncAndBackPorch = vSync + CVT_MIN_V_PORCH;
+    mode.vTotal = mode.vDisplay + vSyncAndBackPorch + CVT_MIN_V_PORCH;
+
+    float hBlankPercentage = float(CVT_C_PRIME - CVT_M_PRIME * hPeriod / 1000.0);
+    if (hBlankPercentage < 20)
+      hBlankPercentage = 20;
+    int hBlank = int(mode.hDisplay * hBlankPercentage / (100.0 - hBlankPercentage));
+    hBlank -= hBlank % (2 * CVT_H_GRANULARITY);
+
+    mode.hTotal = mode.hDisplay + hBlank;
+    mode.hSyncEnd = mode.hDisplay + hBlank / 2;
+    mode.hSyncStart = mode.hSyncEnd - (mode.hTotal * CVT_HSYNC_PERCENTAGE) / 100;
+    mode.hSyncStart += CVT_H_GRANULARITY - mode.hSyncStart % CVT_H_GRANULARITY;
+    mode.vSyncStart = mode.vDisplay + CVT_MIN_V_PORCH;
+    mode.vSyncEnd = mode.vSyncStart + vSync;
+    mode.hSyncPositive = false;
+    mode.vSyncPositive = true;
+  }
+  else
+  {
+    hPeriod = float(1000000.0 / vFieldRate - CVT_RB_MIN_VBLANK) / mode.vDisplay;
+    int vbiLines = int(float(CVT_RB_MIN_VBLANK) / hPeriod + 1);
+    if (vbiLines < CVT_RB_VFPORCH + vSync + CVT_MIN_V_BPORCH)
+      vbiLines = CVT_RB_VFPORCH + vSync + CVT_MIN_V_BPORCH;
+    mode.vTotal = mode.vDisplay + vbiLines;
+    mode.hTotal = mode.hDisplay + CVT_RB_H_BLANK;
+    mode.hSyncEnd = mode.hDisplay + CVT_RB_H_BLANK / 2;
+    mode.hSyncStart = mode.hSyncEnd - CVT_RB_H_SYNC;
+    mode.vSyncStart = mode.vDisplay + CVT_RB_VFPORCH;
+    mode.vSyncEnd = mode.vSyncStart + vSync;
+    mode.hSyncPositive = true;
+    mode.vSyncPositive = false;
+  }
+
+  int clockKHz = int(mode.hTotal * 1000.0 / hPeriod);
+  clockKHz -= clockKHz % CVT_CLOCK_STEP;
+  mode.clockMHz = clockKHz / 1000.0;
+
+  if (reducedBlanking)
+    mode.name = QString("%1x%2R").arg(width).arg(height);
+  else
+    mode.name = QString("%1x%2_%3").arg(width).arg(height).arg(refresh, 0, 'f', 2);
+  return mode;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QtCore>
+
+struct Modeline
+{
+  QString name;
+  double clockMHz = 0.0;
+  int hDisplay = 0;
+  int hSyncStart = 0;
+  int hSyncEnd = 0;
+  int hTotal = 0;
+  int vDisplay = 0;
+  int vSyncStart = 0;
+  int vSyncEnd = 0;
+  int vTotal = 0;
+  bool hSyncPositive = false;
+  bool vSyncPositive = true;
+
+  double horizontalFrequencyKHz() const { return hTotal > 0 ? clockMHz * 1000.0 / hTotal : 0.0; }
+  double refreshRate() const { return hTotal > 0 && vTotal > 0 ? clockMHz * 1e6 / (double(hTotal) * vTotal) : 0.0; }
+  // Timing part as accepted by "xrandr --newmode <name> ..." and Xorg's Modeline option.
+  QStringList timingArguments() const;
+};
+
+// Computes a VESA CVT mode line, identical to the output of the cvt(1) utility.
+Modeline cvtModeline(int width, int height, double refresh = 60.0, bool reducedBlanking = false);
@@ -1,4 +1,7 @@
 #include "monitoritem.h"
+#include "layoutgeometry.h"
+#include "layoutmodel.h"
+#include "tracer.h"
 #include "xinputbackend.h"
 #include "xrandrbackend.h"
 #include <QtWidgets>
@@ -8,20 +11,18 @@ namespace
 {
   constexpr double SNAP_DISTANCE = 15.0;
 
-  bool touchDeviceExists(const QString &mapping)
-  {
-    QStringList parts = mapping.split("||");
-    if (parts.size() < 2)
-      return false;
-    QString idPath = parts.at(0).trimmed();
-    QString name = parts.at(1).trimmed();
-    const QList<XInputDevice> devices = XInputBackend::instance().devices();
-    for (const XInputDevice &dev : devices) {
-      if (dev.idPath == idPath && dev.name == name)
-        return true;
-    }
-    return false;
-  }
+  // Commands of the Selection menu, applied to all selected monitors.
+  enum class SelectionCommand
+  {
+    AlignLeft,
+    AlignRight,
+    AlignTop,
+    AlignBottom,
+    ArrangeRow,
+    ArrangeColumn,
+    RotateClockwise,
+    RotateCounterclockwise
+  };
 
   class ClickableOverlay : public QWidget
   {
@@ -41,115 +42,280 @@ namespace
   };
 }
 
-MonitorItem::MonitorItem(const QString &screenName)
-:m_screenName(screenName),
-m_orientation(Orientation::Normal),
-m_isPrimary(false),
-m_settings("Orgelmakerij Noorlander B.V.", "dpset")
+MonitorItem::MonitorItem(LayoutModel *model, int index)
+:m_model(model),
+m_index(index)
+{
+  TraceScope constructScope("MonitorItem::MonitorItem");
+  constructScope.setArg("screen", output().name);
+  setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable
+           | QGraphicsItem::ItemSendsGeometryChanges);
+  // Items are redrawn from a pixmap when other items move or the view pans.
+  setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+  m_label.setText(output().name);
+  m_label.setTextFormat(Qt::PlainText);
+  m_label.setPerformanceHint(QStaticText::AggressiveCaching);
+  m_label.prepare(QTransform(), labelFont());
+  syncFromModel();
+}
+
+const LayoutOutput &MonitorItem::output() const
+{
+  return m_model->output(m_index);
+}
+
+void MonitorItem::syncFromModel()
 {
-  const auto &map = XRandrBackend::instance().monitors();
-  if (map.contains(m_screenName))
+  const LayoutOutput &out = output();
+  const QSize size = m_model->rect(m_index).size();
+  setRect(0, 0, size.width() * kScaleFactor, size.height() * kScaleFactor);
+  if (out.cloneOf != m_cloneOf)
   {
-    const XRandrMonitorInfo &info = map.value(m_screenName);
-    m_currentResolution = info.currentResolution;
-    m_isPrimary = info.isPrimary;
-    m_orientation = info.orientation;
-    m_possibleResolutions = info.allResolutions;
+    // A clone is stacked just below and behind its source and moves with it.
+    m_cloneOf = out.cloneOf;
+    setZValue(out.isClone() ? -1 : 0);
+    setFlag(QGraphicsItem::ItemIsMovable, !out.isClone());
+    updateToolTip();
+    update();
   }
-  else
+  if (out.orientation != m_labelOrientation)
   {
-    m_currentResolution = QSize(1024, 768);
-    m_isPrimary = false;
-    m_orientation = Orientation::Normal;
+    m_labelOrientation = out.orientation;
+    update();
   }
-  updateRectFromResolutionAndAngle();
-  if(map.contains(m_screenName))
+  QList<QLineF> seams;
+  QStringList tileOutputs;
+  for (const LayoutTile &tile : out.tiles)
   {
-    auto info = map.value(m_screenName);
-    setPos(info.position.x() * kScaleFactor, info.position.y() * kScaleFactor);
+    tileOutputs << tile.output;
+    // Only the left and top edges inside the display are seams.
+    const QRect r = out.tileRect(tile);
+    const QRectF scaled(r.x() * kScaleFactor, r.y() * kScaleFactor, r.width() * kScaleFactor, r.height() * kScaleFactor);
+    if (r.x() > 0)
+      seams << QLineF(scaled.topLeft(), scaled.bottomLeft());
+    if (r.y() > 0)
+      seams << QLineF(scaled.topLeft(), scaled.topRight());
   }
-  setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable
-           | QGraphicsItem::ItemSendsGeometryChanges);
-  setOpacity(0.5);
-  m_nameItem = new QGraphicsTextItem(m_screenName, this);
-  updateTextAngle();
-
-  m_settings.beginGroup("TouchDeviceMappings");
-  QString savedMapping = m_settings.value(m_screenName).toString();
-  if (!savedMapping.isEmpty() && touchDeviceExists(savedMapping))
+  if (!out.isTiled())
+    tileOutputs.clear();
+  if (seams != m_tileSeams || tileOutputs != m_tileOutputs)
   {
-    QStringList parts = savedMapping.split("||");
-    if (parts.size() >= 2)
-    {
-      m_touchDeviceIdPath = parts.at(0).trimmed();
-      m_touchDeviceName = parts.at(1).trimmed();
-    }
+    m_tileSeams = seams;
+    m_tileOutputs = tileOutputs;
+    updateToolTip();
+    update();
+  }
+  const bool emulated = out.isRotationEmulated();
+  if (emulated != m_emulatedRotation)
+  {
+    m_emulatedRotation = emulated;
+    updateToolTip();
+    update();
+  }
+  QPointF position(out.position.x() * kScaleFactor, out.position.y() * kScaleFactor);
+  if (out.isClone())
+    position += QPointF(kCloneOffset, kCloneOffset);
+  if (pos() != position)
+  {
+    m_syncing = true;
+    setPos(position);
+    m_syncing = false;
   }
-  m_settings.endGroup();
 }
 
-void MonitorItem::setTouchDeviceIdPath(const QString &path)
+double MonitorItem::scaleFactor()
+{
+  return kScaleFactor;
+}
+
+QPoint MonitorItem::toLayoutPoint(const QPointF &scenePos)
+{
+  return QPoint(qRound(scenePos.x() / kScaleFactor), qRound(scenePos.y() / kScaleFactor));
+}
+
+QFont MonitorItem::labelFont()
+{
+  static const QFont font = QGuiApplication::font();
+  return font;
+}
+
+QString MonitorItem::emulatedRotationHint()
+{
+  return tr("The CRTC cannot rotate this way itself. The X server renders the output "
+            "through a shadow framebuffer, which costs CPU time and adds a frame of latency.");
+}
+
+void MonitorItem::setIssues(const QStringList &issues)
+{
+  if (m_issues == issues)
+    return;
+  m_issues = issues;
+  updateToolTip();
+  update();
+}
+
+void MonitorItem::updateToolTip()
+{
+  QStringList lines = m_issues;
+  if (!m_cloneOf.isEmpty())
+    lines << tr("Shows the picture of %1.").arg(m_cloneOf);
+  if (!m_tileOutputs.isEmpty())
+    lines << tr("Tiled display driven by %1 at their native timing.").arg(m_tileOutputs.join(", "));
+  if (m_emulatedRotation)
+    lines << emulatedRotationHint();
+  setToolTip(lines.join('\n'));
+}
+
+void MonitorItem::setOverlapping(bool overlapping)
 {
-  m_touchDeviceIdPath = path;
-  m_settings.beginGroup("TouchDeviceMappings");
-  m_settings.setValue(m_screenName, m_touchDeviceIdPath + "||" + m_touchDeviceName);
-  m_settings.endGroup();
+  if (m_overlapping == overlapping)
+    return;
+  m_overlapping = overlapping;
+  update();
 }
 
-void MonitorItem::setTouchDeviceName(const QString &name)
+QList<int> MonitorItem::groupIndices() const
 {
-  m_touchDeviceName = name;
-  m_settings.beginGroup("TouchDeviceMappings");
-  m_settings.setValue(m_screenName, m_touchDeviceIdPath + "||" + m_touchDeviceName);
-  m_settings.endGroup();
+  if (!isSelected() || !scene())
+    return {m_index};
+  QList<int> indices;
+  const QList<QGraphicsItem *> selected = scene()->selectedItems();
+  for (QGraphicsItem *item : selected)
+  {
+    if (MonitorItem *monItem = dynamic_cast<MonitorItem *>(item))
+      indices.append(monItem->index());
+  }
+  return indices;
 }
 
-void MonitorItem::setPrimary(bool primary)
+void MonitorItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
-  if (!scene())
+  QGraphicsRectItem::mousePressEvent(event);
+  m_dragIndices.clear();
+  if (event->button() != Qt::LeftButton)
     return;
-  if (primary)
+
+  // The selection moves as one rigid body: remember where it started and
+  // what it can snap to, so every mouse move only snaps its outer edges.
+  // Clones are not dragged themselves; they follow their sources.
+  const QList<int> group = groupIndices();
+  for (int index : group)
   {
-    for (QGraphicsItem *item : scene()->items())
-    {
-      if (MonitorItem *otherMon = dynamic_cast<MonitorItem *>(item))
-        otherMon->m_isPrimary = false;
-    }
-    m_isPrimary = true;
+    if (!m_model->output(index).isClone())
+      m_dragIndices.append(index);
   }
-  else
+  if (m_dragIndices.isEmpty())
+    return;
+  m_dragStartPositions.clear();
+  for (int index : std::as_const(m_dragIndices))
+    m_dragStartPositions.append(m_model->output(index).position);
+  m_dragStartBounds = m_model->bounds(m_dragIndices);
+  m_dragOthers.clear();
+  const QList<LayoutOutput> &outputs = m_model->outputs();
+  for (int i = 0; i < outputs.size(); ++i)
   {
-    m_isPrimary = false;
+    if (!m_dragIndices.contains(i) && !outputs.at(i).isClone())
+      m_dragOthers.append(m_model->rect(i));
   }
 }
 
-double MonitorItem::scaleFactor()
+void MonitorItem::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
 {
-  return kScaleFactor;
+  if (!(event->buttons() & Qt::LeftButton) || m_dragIndices.isEmpty())
+  {
+    QGraphicsRectItem::mouseMoveEvent(event);
+    return;
+  }
+  const QPoint offset = toLayoutPoint(event->scenePos() - event->buttonDownScenePos(Qt::LeftButton));
+  const QPoint snapped = offset + snapOffset(m_dragStartBounds.translated(offset), m_dragOthers,
+                                             qRound(SNAP_DISTANCE / kScaleFactor));
+  QList<QPoint> positions;
+  positions.reserve(m_dragStartPositions.size());
+  for (const QPoint &start : std::as_const(m_dragStartPositions))
+    positions.append(start + snapped);
+  m_model->setPositions(m_dragIndices, positions);
+}
+
+void MonitorItem::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
+{
+  m_dragIndices.clear();
+  m_dragOthers.clear();
+  QGraphicsRectItem::mouseReleaseEvent(event);
 }
 
 QVariant MonitorItem::itemChange(GraphicsItemChange change, const QVariant &value)
 {
-  if (change == ItemPositionChange && scene())
-  {
-    QPointF proposedPos = value.toPointF();
-    double snappedX = snapX(proposedPos.x());
-    double snappedY = snapY(proposedPos.y());
-    return QPointF(snappedX, snappedY);
-  }
+  if (change == ItemPositionHasChanged && !m_syncing)
+    m_model->setPosition(m_index, toLayoutPoint(value.toPointF()));
   return QGraphicsRectItem::itemChange(change, value);
 }
 
 void MonitorItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
   Q_UNUSED(widget);
-  painter->setBrush(Qt::lightGray);
   bool isSelected = (option->state & QStyle::State_Selected);
-  if (isSelected)
-    painter->setPen(QPen(Qt::black, 2, Qt::DotLine));
-  else
-    painter->setPen(QPen(Qt::black, 2, Qt::SolidLine));
+  QColor penColor = m_overlapping ? Qt::red : Qt::black;
+  // Cosmetic pen: the outline stays 2 px wide at every zoom level.
+  QPen pen(penColor, 2, isSelected ? Qt::DotLine : (m_cloneOf.isEmpty() ? Qt::SolidLine : Qt::DashLine));
+  pen.setCosmetic(true);
+  painter->setPen(pen);
+  // Amber marks an output whose rotation costs a shadow framebuffer.
+  painter->setBrush(m_emulatedRotation ? QColor(255, 193, 7, 128) : QColor(211, 211, 211, 128));
   painter->drawRect(rect());
+
+  if (!m_tileSeams.isEmpty())
+  {
+    QPen seamPen(penColor, 1, Qt::DotLine);
+    seamPen.setCosmetic(true);
+    painter->setPen(seamPen);
+    painter->drawLines(m_tileSeams);
+  }
+
+  if (!m_issues.isEmpty())
+  {
+    // Warning badge in the top-left corner; the tooltip lists the problems.
+    const qreal radius = qMin(rect().width(), rect().height()) * 0.12;
+    const QRectF badge(rect().topLeft() + QPointF(radius * 0.5, radius * 0.5), QSizeF(2 * radius, 2 * radius));
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(211, 47, 47));
+    painter->drawEllipse(badge);
+    QFont font = labelFont();
+    font.setBold(true);
+    font.setPixelSize(qMax(1, qRound(radius * 1.5)));
+    painter->setFont(font);
+    painter->setPen(Qt::white);
+    painter->drawText(badge, Qt::AlignCenter, "!");
+  }
+
+  // Level of detail: skip the label once it would be too small to read.
+  const QSizeF labelSize = m_label.size();
+  const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+  if (labelSize.height() * lod < 4.0)
+    return;
+
+  qreal angle = 0;
+  switch (m_labelOrientation)
+  {
+    case Orientation::Normal:
+      angle = 0;
+      break;
+    case Orientation::Left:
+      angle = 90;
+      break;
+    case Orientation::Inverted:
+      angle = 180;
+      break;
+    case Orientation::Right:
+      angle = 270;
+      break;
+  }
+  painter->save();
+  painter->translate(rect().center());
+  painter->rotate(angle);
+  painter->setFont(labelFont());
+  painter->setPen(Qt::black);
+  painter->drawStaticText(QPointF(-labelSize.width() * 0.5, -labelSize.height() * 0.5), m_label);
+  painter->restore();
 }
 
 QRectF MonitorItem::boundingRect() const
@@ -166,61 +332,180 @@ QPainterPath MonitorItem::shape() const
 
 void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
 {
+  const LayoutOutput &out = output();
   QMenu menu;
   QAction *identifyAction = menu.addAction(tr("Identify"));
   menu.addSeparator();
   QAction *primaryAction = menu.addAction(tr("Primary"));
   primaryAction->setCheckable(true);
-  primaryAction->setChecked(m_isPrimary);
+  primaryAction->setChecked(out.primary);
+
+  const QList<int> group = groupIndices();
+  QMenu *selectionMenu = nullptr;
+  QList<QAction *> selectionActions;
+  if (group.size() > 1)
+  {
+    selectionMenu = menu.addMenu(tr("Selection"));
+    struct { QString label; SelectionCommand command; } commands[] = {
+        { tr("Align left edges"), SelectionCommand::AlignLeft },
+        { tr("Align right edges"), SelectionCommand::AlignRight },
+        { tr("Align top edges"), SelectionCommand::AlignTop },
+        { tr("Align bottom edges"), SelectionCommand::AlignBottom },
+        { tr("Arrange in a row"), SelectionCommand::ArrangeRow },
+        { tr("Arrange in a column"), SelectionCommand::ArrangeColumn },
+        { tr("Rotate clockwise"), SelectionCommand::RotateClockwise },
+        { tr("Rotate counterclockwise"), SelectionCommand::RotateCounterclockwise }
+    };
+    for (auto &c : commands)
+    {
+      if (c.command == SelectionCommand::ArrangeRow || c.command == SelectionCommand::RotateClockwise)
+        selectionMenu->addSeparator();
+      QAction *act = selectionMenu->addAction(c.label);
+      act->setData(static_cast<int>(c.command));
+      selectionActions << act;
+    }
+  }
+
+  QMenu *cloneMenu = menu.addMenu(tr("Mirror"));
+  cloneMenu->setToolTipsVisible(true);
+  // Each tile of a tiled display needs a CRTC of its own.
+  cloneMenu->setEnabled(!out.isTiled());
+  QAction *noCloneAction = cloneMenu->addAction(tr("(none)"));
+  noCloneAction->setCheckable(true);
+  noCloneAction->setChecked(!out.isClone());
+  noCloneAction->setData(QString());
+  for (const LayoutOutput &other : m_model->outputs())
+  {
+    if (other.name == out.name || other.isClone() || other.isTiled())
+      continue;
+    QAction *act = cloneMenu->addAction(other.name);
+    act->setCheckable(true);
+    act->setChecked(other.name == out.cloneOf);
+    act->setData(other.name);
+    // Only the same mode lets the outputs share a CRTC; otherwise the picture is scaled.
+    if (other.mode != out.mode)
+      act->setToolTip(tr("Scaled from %1x%2").arg(other.mode.width()).arg(other.mode.height()));
+  }
 
   QMenu *resMenu = menu.addMenu(tr("Resolution"));
-  for (const QSize &res : m_possibleResolutions)
+  // The tiles of a tiled display run at their native timing only.
+  resMenu->setEnabled(!out.isTiled());
+  for (const QSize &res : out.availableModes)
   {
     QString resText = QString("%1x%2").arg(res.width()).arg(res.height());
     QAction *act = resMenu->addAction(resText);
     act->setCheckable(true);
-    if(res == m_currentResolution)
+    if(res == out.mode)
     {
       act->setChecked(true);
     }
     act->setData(QVariant::fromValue(res));
   }
-  if(!m_possibleResolutions.contains(m_currentResolution))
+  if(out.isCustomMode())
   {
     resMenu->addSeparator();
     QString customResText = tr("Custom: ") + QString("%1x%2")
-                                                 .arg(m_currentResolution.width())
-                                                 .arg(m_currentResolution.height());
+                                                 .arg(out.mode.width())
+                                                 .arg(out.mode.height());
     QAction *customResItem = resMenu->addAction(customResText);
     customResItem->setCheckable(true);
     customResItem->setChecked(true);
-    customResItem->setData(QVariant::fromValue(m_currentResolution));
+    customResItem->setData(QVariant::fromValue(out.mode));
   }
   resMenu->addSeparator();
   QAction *setCustomResAction = resMenu->addAction(tr("Set Custom Resolution..."));
 
   QMenu *orientMenu = menu.addMenu(tr("Orientation"));
+  orientMenu->setToolTipsVisible(true);
+  // A clone shows the picture of its source the way the source does.
+  orientMenu->setEnabled(!out.isClone());
   struct { Orientation orient; QString label; } orients[] = {
       { Orientation::Normal, tr("Normal") },
       { Orientation::Left, tr("Left") },
       { Orientation::Inverted, tr("Inverted") },
       { Orientation::Right, tr("Right") }
   };
+  QList<QAction *> orientActions;
   for (auto &o : orients)
   {
-    QAction *oa = orientMenu->addAction(o.label);
+    // Rotations the CRTC cannot do are emulated with a transform.
+    const bool native = out.isNativeRotation(o.orient);
+    QAction *oa = orientMenu->addAction(native ? o.label : tr("%1 (emulated)").arg(o.label));
     oa->setCheckable(true);
-    if(m_orientation == o.orient)
+    if(out.orientation == o.orient)
     {
       oa->setChecked(true);
     }
+    if (!native)
+      oa->setToolTip(emulatedRotationHint());
     oa->setData(static_cast<int>(o.orient));
+    orientActions << oa;
+  }
+  QAction *reflectXAction = nullptr;
+  QAction *reflectYAction = nullptr;
+  const bool reflectedX = out.reflection == Reflection::X || out.reflection == Reflection::XY;
+  const bool reflectedY = out.reflection == Reflection::Y || out.reflection == Reflection::XY;
+  if (out.canReflectX || out.canReflectY)
+    orientMenu->addSeparator();
+  if (out.canReflectX)
+  {
+    reflectXAction = orientMenu->addAction(tr("Mirror horizontally"));
+    reflectXAction->setCheckable(true);
+    reflectXAction->setChecked(reflectedX);
   }
+  if (out.canReflectY)
+  {
+    reflectYAction = orientMenu->addAction(tr("Mirror vertically"));
+    reflectYAction->setCheckable(true);
+    reflectYAction->setChecked(reflectedY);
+  }
+
+  QMenu *propertiesMenu = menu.addMenu(tr("Output properties"));
+  QList<QAction *> propertyActions;
+  const QMap<QString, XRandrOutputProperty> propertyInfo = XRandrBackend::instance().monitors().value(out.name).properties;
+  for (const QString &name : XRandrBackend::tunableProperties())
+  {
+    auto it = propertyInfo.constFind(name);
+    if (it == propertyInfo.constEnd())
+      continue;
+    QStringList values = it->supported;
+    if (it->hasRange && name == "max bpc")
+    {
+      for (int bpc : {6, 8, 10, 12, 16})
+      {
+        if (bpc >= it->rangeMin && bpc <= it->rangeMax)
+          values << QString::number(bpc);
+      }
+    }
+    if (values.isEmpty())
+      continue;
+    QMenu *valueMenu = propertiesMenu->addMenu(name);
+    const QString current = out.properties.value(name, it->value);
+    for (const QString &value : std::as_const(values))
+    {
+      QAction *act = valueMenu->addAction(value);
+      act->setCheckable(true);
+      act->setChecked(value == current);
+      act->setData(QStringList{name, value});
+      propertyActions << act;
+    }
+  }
+  auto vrr = propertyInfo.constFind("vrr_capable");
+  if (vrr != propertyInfo.constEnd())
+  {
+    // Variable refresh is enabled with the driver's VariableRefresh option;
+    // RandR only reports whether the output supports it.
+    QAction *vrrAction = propertiesMenu->addAction(tr("Variable refresh capable"));
+    vrrAction->setCheckable(true);
+    vrrAction->setChecked(vrr->value == "1");
+    vrrAction->setEnabled(false);
+  }
+  propertiesMenu->setEnabled(!propertiesMenu->isEmpty());
 
   QMenu *touchMenu = menu.addMenu(tr("Touch device"));
   QAction *noneTouchAction = touchMenu->addAction(tr("(none)"));
   noneTouchAction->setCheckable(true);
-  bool currentlyNone = m_touchDeviceIdPath.isEmpty();
+  bool currentlyNone = out.touchIdPath.isEmpty();
   noneTouchAction->setChecked(currentlyNone);
   noneTouchAction->setData(QString());
   const auto &allDevices = XInputBackend::instance().devices();
@@ -229,13 +514,16 @@ void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     QString text = QString("%1 (%2)").arg(dev.name).arg(dev.idPath);
     QAction *act = touchMenu->addAction(text);
     act->setCheckable(true);
-    if(dev.idPath == m_touchDeviceIdPath && dev.name == m_touchDeviceName)
+    if(dev.idPath == out.touchIdPath && dev.name == out.touchName)
     {
       act->setChecked(true);
     }
     act->setData(dev.idPath + "||" + dev.name);
   }
 
+  // The menu runs a nested event loop; copy what is needed afterwards.
+  const QString screenName = out.name;
+  const bool isPrimary = out.primary;
   QAction *chosen = menu.exec(event->screenPos());
   if(!chosen)
   {
@@ -248,7 +536,7 @@ void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     const QList<QScreen *> screens = QGuiApplication::screens();
     for (QScreen *screen : screens)
     {
-      if(screen->name() == m_screenName)
+      if(screen->name() == screenName)
       {
         targetScreen = screen;
         break;
@@ -265,7 +553,7 @@ void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     overlayWidget->setWindowModality(Qt::NonModal);
     overlayWidget->setGeometry(screenGeometry);
     QLabel *label = new QLabel(overlayWidget);
-    label->setText(m_screenName);
+    label->setText(screenName);
     QFont font = label->font();
     font.setPointSize(64);
     font.setBold(true);
@@ -277,9 +565,29 @@ void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     QTimer::singleShot(3000, overlayWidget, [overlayWidget]() { overlayWidget->close(); });
     return;
   }
+  if(selectionActions.contains(chosen))
+  {
+    switch (static_cast<SelectionCommand>(chosen->data().toInt()))
+    {
+      case SelectionCommand::AlignLeft: m_model->alignOutputs(group, Qt::AlignLeft); break;
+      case SelectionCommand::AlignRight: m_model->alignOutputs(group, Qt::AlignRight); break;
+      case SelectionCommand::AlignTop: m_model->alignOutputs(group, Qt::AlignTop); break;
+      case SelectionCommand::AlignBottom: m_model->alignOutputs(group, Qt::AlignBottom); break;
+      case SelectionCommand::ArrangeRow: m_model->arrangeOutputs(group, Qt::Horizontal); break;
+      case SelectionCommand::ArrangeColumn: m_model->arrangeOutputs(group, Qt::Vertical); break;
+      case SelectionCommand::RotateClockwise: m_model->rotateOutputs(group, 1); break;
+      case SelectionCommand::RotateCounterclockwise: m_model->rotateOutputs(group, -1); break;
+    }
+    return;
+  }
+  if(cloneMenu->actions().contains(chosen))
+  {
+    m_model->setCloneOf(m_index, chosen->data().toString());
+    return;
+  }
   if(chosen == primaryAction)
   {
-    setPrimary(!m_isPrimary);
+    m_model->setPrimary(m_index, !isPrimary);
     return;
   }
   if(resMenu->actions().contains(chosen))
@@ -300,7 +608,7 @@ void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
           int height = parts.at(1).toInt(&okHeight);
           if(okWidth && okHeight && width > 0 && height > 0)
           {
-            setResolution(QSize(width, height));
+            m_model->setMode(m_index, QSize(width, height));
           }
           else
           {
@@ -317,14 +625,28 @@ void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     else
     {
       QSize newRes = chosen->data().value<QSize>();
-      setResolution(newRes);
+      m_model->setMode(m_index, newRes);
       return;
     }
   }
-  if(orientMenu->actions().contains(chosen))
+  if(orientActions.contains(chosen))
   {
     int val = chosen->data().toInt();
-    setOrientation(static_cast<Orientation>(val));
+    m_model->setOrientation(m_index, static_cast<Orientation>(val));
+    return;
+  }
+  if(chosen && (chosen == reflectXAction || chosen == reflectYAction))
+  {
+    const bool x = chosen == reflectXAction ? !reflectedX : reflectedX;
+    const bool y = chosen == reflectYAction ? !reflectedY : reflectedY;
+    m_model->setReflection(m_index, x ? (y ? Reflection::XY : Reflection::X)
+                                      : (y ? Reflection::Y : Reflection::None));
+    return;
+  }
+  if(propertyActions.contains(chosen))
+  {
+    const QStringList data = chosen->data().toStringList();
+    m_model->setProperty(m_index, data.at(0), data.at(1));
     return;
   }
   if(touchMenu->actions().contains(chosen))
@@ -332,184 +654,17 @@ void MonitorItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     QString data = chosen->data().toString();
     if(data.isEmpty())
     {
-      setTouchDeviceIdPath("");
-      setTouchDeviceName("");
+      m_model->setTouchDevice(m_index, QString(), QString());
     }
     else
     {
       QStringList parts = data.split("||");
       if(parts.size() >= 2)
-      {
-        setTouchDeviceIdPath(parts.at(0));
-        setTouchDeviceName(parts.at(1));
-      }
+        m_model->setTouchDevice(m_index, parts.at(0), parts.at(1));
       else
-      {
-        setTouchDeviceIdPath(data);
-        setTouchDeviceName("");
-      }
+        m_model->setTouchDevice(m_index, data, QString());
     }
+    m_model->saveTouchMapping(m_index);
     return;
   }
 }
-
-void MonitorItem::setResolution(const QSize &res)
-{
-  m_currentResolution = res;
-  updateRectFromResolutionAndAngle();
-  updateTextAngle();
-}
-
-void MonitorItem::setOrientation(Orientation orient)
-{
-  m_orientation = orient;
-  updateRectFromResolutionAndAngle();
-  updateTextAngle();
-}
-
-void MonitorItem::updateRectFromResolutionAndAngle()
-{
-  double w = m_currentResolution.width();
-  double h = m_currentResolution.height();
-  if (m_orientation == Orientation::Left || m_orientation == Orientation::Right)
-  {
-    double tmp = w;
-    w = h;
-    h = tmp;
-  }
-  double sw = w * kScaleFactor;
-  double sh = h * kScaleFactor;
-  setRect(0, 0, sw, sh);
-}
-
-void MonitorItem::updateTextAngle()
-{
-  if (!m_nameItem)
-    return;
-  qreal angle = 0;
-  switch (m_orientation)
-  {
-    case Orientation::Normal:
-      angle = 0;
-      break;
-    case Orientation::Left:
-      angle = 90;
-      break;
-    case Orientation::Inverted:
-      angle = 180;
-      break;
-    case Orientation::Right:
-      angle = 270;
-      break;
-  }
-  QRectF tb = m_nameItem->boundingRect();
-  m_nameItem->setTransformOriginPoint(tb.center());
-  m_nameItem->setRotation(angle);
-  double bw = rect().width();
-  double bh = rect().height();
-  double tw = tb.width();
-  double th = tb.height();
-  double cx = bw * 0.5 - tw * 0.5;
-  double cy = bh * 0.5 - th * 0.5;
-  m_nameItem->setPos(cx, cy);
-}
-
-double MonitorItem::snapX(double proposedX)
-{
-  QRectF futureRect(QPointF(proposedX, pos().y()), rect().size());
-  double bestX = proposedX;
-  double minDelta = std::numeric_limits<double>::max();
-  for (QGraphicsItem *other : scene()->items())
-  {
-    if (other == this)
-      continue;
-    auto otherRectItem = dynamic_cast<QGraphicsRectItem *>(other);
-    if (!otherRectItem)
-      continue;
-    QRectF oRect = otherRectItem->sceneBoundingRect();
-    trySnapHorizontal(futureRect.left(), oRect.left(), futureRect.width(), false, bestX, minDelta);
-    trySnapHorizontal(futureRect.left(), oRect.right(), futureRect.width(), false, bestX, minDelta);
-    trySnapHorizontal(futureRect.right(), oRect.left(), futureRect.width(), true, bestX, minDelta);
-    trySnapHorizontal(futureRect.right(), oRect.right(), futureRect.width(), true, bestX, minDelta);
-  }
-  QRectF sRect = scene()->sceneRect();
-  double deltaLeft = futureRect.left() - sRect.left();
-  if (qAbs(deltaLeft) < SNAP_DISTANCE && qAbs(deltaLeft) < minDelta)
-  {
-    minDelta = qAbs(deltaLeft);
-    bestX = proposedX - deltaLeft;
-  }
-  double deltaRight = futureRect.right() - sRect.right();
-  if (qAbs(deltaRight) < SNAP_DISTANCE && qAbs(deltaRight) < minDelta)
-  {
-    minDelta = qAbs(deltaRight);
-    bestX = proposedX - deltaRight;
-  }
-  return bestX;
-}
-
-double MonitorItem::snapY(double proposedY)
-{
-  QRectF futureRect(QPointF(pos().x(), proposedY), rect().size());
-  double bestY = proposedY;
-  double minDelta = std::numeric_limits<double>::max();
-  for (QGraphicsItem *other : scene()->items())
-  {
-    if (other == this)
-      continue;
-    auto otherRectItem = dynamic_cast<QGraphicsRectItem *>(other);
-    if (!otherRectItem)
-      continue;
-    QRectF oRect = otherRectItem->sceneBoundingRect();
-    trySnapVertical(futureRect.top(), oRect.top(), futureRect.height(), false, bestY, minDelta);
-    trySnapVertical(futureRect.top(), oRect.bottom(), futureRect.height(), false, bestY, minDelta);
-    trySnapVertical(futureRect.bottom(), oRect.top(), futureRect.height(), true, bestY, minDelta);
-    trySnapVertical(futureRect.bottom(), oRect.bottom(), futureRect.height(), true, bestY, minDelta);
-  }
-  QRectF sRect = scene()->sceneRect();
-  double deltaTop = futureRect.top() - sRect.top();
-  if (qAbs(deltaTop) < SNAP_DISTANCE && qAbs(deltaTop) < minDelta)
-  {
-    minDelta = qAbs(deltaTop);
-    bestY = proposedY - deltaTop;
-  }
-  double deltaBottom = futureRect.bottom() - sRect.bottom();
-  if (qAbs(deltaBottom) < SNAP_DISTANCE && qAbs(deltaBottom) < minDelta)
-  {
-    minDelta = qAbs(deltaBottom);
-    bestY = proposedY - deltaBottom;
-  }
-  return bestY;
-}
-
-void MonitorItem::trySnapHorizontal(double myEdge,
-				    double otherEdge,
-				    double myWidth,
-				    bool edgeIsRight,
-				    double &bestX,
-				    double &minDelta)
-{
-  double delta = qAbs(myEdge - otherEdge);
-  if (delta < SNAP_DISTANCE && delta < minDelta)
-  {
-    minDelta = delta;
-    double shift = otherEdge - myEdge;
-    bestX += shift;
-  }
-}
-
-void MonitorItem::trySnapVertical(double myEdge,
-				  double otherEdge,
-				  double myHeight,
-				  bool edgeIsBottom,
-				  double &bestY,
-				  double &minDelta)
-{
-  double delta = qAbs(myEdge - otherEdge);
-  if (delta < SNAP_DISTANCE && delta < minDelta)
-  {
-    minDelta = delta;
-    double shift = otherEdge - myEdge;
-    bestY += shift;
-  }
-}
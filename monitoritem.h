@@ -2,47 +2,59 @@
 
 #include <QtCore>
 #include <QGraphicsRectItem>
+#include <QStaticText>
 #include "orientation.h"
 
+class LayoutModel;
+struct LayoutOutput;
+
+// View of one output of a LayoutModel; all state lives in the model.
 class MonitorItem : public QObject, public QGraphicsRectItem
 {
   Q_OBJECT
 public:
-  explicit MonitorItem(const QString &screenName);
-  QString screenName() const { return m_screenName; }
-  QSize currentResolution() const { return m_currentResolution; }
-  bool isPrimary() const { return m_isPrimary; }
-  Orientation orientation() const { return m_orientation; }
-  QString touchDeviceIdPath() const { return m_touchDeviceIdPath; }
-  void setTouchDeviceIdPath(const QString &path);
-  QString touchDeviceName() const { return m_touchDeviceName; }
-  void setTouchDeviceName(const QString &name);
-  void setPrimary(bool primary);
-  double scaleFactor();
+  MonitorItem(LayoutModel *model, int index);
+  int index() const { return m_index; }
+  void syncFromModel();
+  void setOverlapping(bool overlapping);
+  // Problems found by validateLayout(), shown as a badge and in the tooltip.
+  void setIssues(const QStringList &issues);
+  static double scaleFactor();
+  static QPoint toLayoutPoint(const QPointF &scenePos);
 protected:
   QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
   void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
   QRectF boundingRect() const override;
   QPainterPath shape() const override;
   void contextMenuEvent(QGraphicsSceneContextMenuEvent *event) override;
+  void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
+  void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
+  void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 private:
   static constexpr double kScaleFactor = 0.1;
-  QString m_screenName;
-  QSize m_currentResolution;
-  QString m_touchDeviceIdPath;
-  QString m_touchDeviceName;
-  bool m_isPrimary;
-  Orientation m_orientation;
-  QList<QSize> m_possibleResolutions;
-  QGraphicsTextItem *m_nameItem = nullptr;
-  QSettings m_settings;
+  // Scene offset that keeps a clone visible below its source.
+  static constexpr double kCloneOffset = 8.0;
+  LayoutModel *m_model;
+  int m_index;
+  QStaticText m_label;
+  Orientation m_labelOrientation = Orientation::Normal;
+  bool m_syncing = false;
+  bool m_overlapping = false;
+  bool m_emulatedRotation = false;
+  QString m_cloneOf;
+  // Seams between the tiles of a tiled display, in item coordinates.
+  QList<QLineF> m_tileSeams;
+  QStringList m_tileOutputs;
+  QStringList m_issues;
+  QList<int> m_dragIndices;
+  QList<QPoint> m_dragStartPositions;
+  QRect m_dragStartBounds;
+  QList<QRect> m_dragOthers;
 
-  void setResolution(const QSize &res);
-  void setOrientation(Orientation orient);
-  void updateRectFromResolutionAndAngle();
-  void updateTextAngle();
-  double snapX(double proposedX);
-  double snapY(double proposedY);
-  void trySnapHorizontal(double myEdge, double otherEdge, double myWidth, bool edgeIsRight, double &bestX, double &minDelta);
-  void trySnapVertical(double myEdge, double otherEdge, double myHeight, bool edgeIsBottom, double &bestY, double &minDelta);
+  const LayoutOutput &output() const;
+  static QFont labelFont();
+  static QString emulatedRotationHint();
+  void updateToolTip();
+  // Indices of the selected outputs when this item is part of the selection.
+  QList<int> groupIndices() const;
 };
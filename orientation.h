@@ -33,3 +33,34 @@ inline Orientation stringToOrientation(const QString &str)
         return Orientation::Right;
     return Orientation::Normal;
 }
+
+enum class Reflection {
+    None,
+    X,
+    Y,
+    XY
+};
+
+// Values of xrandr --reflect.
+inline QString reflectionToString(Reflection reflection)
+{
+    switch (reflection) {
+    case Reflection::None: return "normal";
+    case Reflection::X:    return "x";
+    case Reflection::Y:    return "y";
+    case Reflection::XY:   return "xy";
+    }
+    return "normal";
+}
+
+inline Reflection stringToReflection(const QString &str)
+{
+    const QString s = str.toLower();
+    if (s == "xy")
+        return Reflection::XY;
+    if (s == "x")
+        return Reflection::X;
+    if (s == "y")
+        return Reflection::Y;
+    return Reflection::None;
+}
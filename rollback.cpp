@@ -0,0 +1,105 @@
+#include "rollback.h"
+#include "applypipeline.h"
+
+Rollback::Rollback(QObject *parent)
+:QObject(parent)
+{
+  m_pipeline = new ApplyPipeline(this);
+  connect(m_pipeline, &ApplyPipeline::finished, this, [this](bool ok, const QString &message)
+  {
+    if (!ok)
+    {
+      emit finished(false, message);
+      return;
+    }
+    emit finished(true, tr("Previous layout restored in %1 ms").arg(m_restoreTimer.elapsed()));
+  });
+
+  m_countdown.setInterval(1000);
+  connect(&m_countdown, &QTimer::timeout, this, [this]()
+  {
+    --m_secondsLeft;
+    if (m_secondsLeft <= 0)
+      rollback();
+    else
+      emit countdown(m_secondsLeft);
+  });
+}
+
+bool Rollback::capture()
+{
+  stopCountdown();
+  m_snapshot = StateSnapshot::capture();
+  if (!m_snapshot.isValid())
+    return false;
+  // On disk, so "dpset --rollback" still works when this process is gone.
+  m_snapshot.save(StateSnapshot::defaultPath());
+  return true;
+}
+
+bool Rollback::load(const QString &path)
+{
+  m_snapshot = StateSnapshot::load(path);
+  return m_snapshot.isValid();
+}
+
+bool Rollback::isRunning() const
+{
+  return m_pending || m_pipeline->isRunning();
+}
+
+void Rollback::startCountdown(int seconds)
+{
+  if (!m_snapshot.isValid())
+    return;
+  m_secondsLeft = seconds;
+  m_countdown.start();
+  emit countdown(m_secondsLeft);
+}
+
+void Rollback::waitFor(ApplyPipeline *pipeline)
+{
+  m_others << pipeline;
+  connect(pipeline, &ApplyPipeline::finished, this, [this]()
+  {
+    if (m_pending)
+      rollback();
+  });
+}
+
+void Rollback::confirm()
+{
+  stopCountdown();
+}
+
+void Rollback::rollback()
+{
+  stopCountdown();
+  if (m_pipeline->isRunning())
+    return;
+  if (!m_snapshot.isValid())
+  {
+    emit finished(false, tr("There is no snapshot to restore."));
+    return;
+  }
+  emit restoring();
+  for (const ApplyPipeline *other : std::as_const(m_others))
+  {
+    if (other->isRunning())
+    {
+      m_pending = true;
+      return;
+    }
+  }
+  m_pending = false;
+  m_restoreTimer.start();
+  m_pipeline->start(m_snapshot.restoreStages());
+}
+
+void Rollback::stopCountdown()
+{
+  if (!m_countdown.isActive())
+    return;
+  m_countdown.stop();
+  emit countdownStopped();
+}
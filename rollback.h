@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QtCore>
+#include "statesnapshot.h"
+
+class ApplyPipeline;
+
+// Guards an apply, or the changes of the live preview, with a snapshot of
+// the state before them. The snapshot is kept in memory and on disk; unless
+// the new layout is confirmed within the countdown it is restored, which
+// takes a single xrandr call instead of rerunning the scripts of the
+// previous layout.
+class Rollback : public QObject
+{
+  Q_OBJECT
+public:
+  static constexpr int kRollbackSeconds = 15;
+
+  explicit Rollback(QObject *parent = nullptr);
+
+  // Captures the current state and writes it to StateSnapshot::defaultPath().
+  bool capture();
+  // Uses a snapshot written by an earlier capture(), e.g. of another process.
+  bool load(const QString &path);
+  const StateSnapshot &snapshot() const { return m_snapshot; }
+  bool isRunning() const;
+  bool isCountingDown() const { return m_countdown.isActive(); }
+  void startCountdown(int seconds = kRollbackSeconds);
+  // Defers a restore until pipeline has finished, so the two never
+  // reconfigure the outputs at the same time.
+  void waitFor(ApplyPipeline *pipeline);
+
+public slots:
+  void confirm();
+  void rollback();
+
+signals:
+  void countdown(int secondsLeft);
+  void countdownStopped();
+  // A restore was requested; it may wait for another pipeline first.
+  void restoring();
+  void finished(bool ok, const QString &message);
+
+private:
+  ApplyPipeline *m_pipeline = nullptr;
+  QList<ApplyPipeline *> m_others;
+  bool m_pending = false;
+  StateSnapshot m_snapshot;
+  QTimer m_countdown;
+  QElapsedTimer m_restoreTimer;
+  int m_secondsLeft = 0;
+
+  void stopCountdown();
+};
@@ -0,0 +1,428 @@
+#include "statesnapshot.h"
+#include "tracer.h"
+#include "xinputbackend.h"
+#include "xrandrbackend.h"
+
+namespace
+{
+  const char *kMatrixProperty = "Coordinate Transformation Matrix";
+
+  // Driver modes are named "WxH" (or "WxHi"); anything else was added with
+  // --newmode and may be gone after a server restart.
+  bool isUserMode(const QString &name)
+  {
+    static const QRegularExpression reDriverMode(R"(^\d+x\d+i?$)");
+    return !name.isEmpty() && !reDriverMode.match(name).hasMatch();
+  }
+
+  QString matrixArgument(const QTransform &t)
+  {
+    if (t.isIdentity())
+      return "none";
+    QStringList values;
+    for (qreal v : {t.m11(), t.m12(), t.m13(), t.m21(), t.m22(), t.m23(), t.m31(), t.m32(), t.m33()})
+      values << QString::number(v + 0.0, 'g', 10);
+    return values.join(',');
+  }
+
+  QJsonArray matrixToJson(const QTransform &t)
+  {
+    return {t.m11(), t.m12(), t.m13(), t.m21(), t.m22(), t.m23(), t.m31(), t.m32(), t.m33()};
+  }
+
+  QTransform matrixFromJson(const QJsonArray &values)
+  {
+    if (values.size() != 9)
+      return {};
+    QTransform t;
+    t.setMatrix(values.at(0).toDouble(), values.at(1).toDouble(), values.at(2).toDouble(),
+                values.at(3).toDouble(), values.at(4).toDouble(), values.at(5).toDouble(),
+                values.at(6).toDouble(), values.at(7).toDouble(), values.at(8).toDouble());
+    return t;
+  }
+
+  QJsonObject modeToJson(const Modeline &mode)
+  {
+    return {
+      {"name", mode.name},
+      {"clock", mode.clockMHz},
+      {"h", QJsonArray{mode.hDisplay, mode.hSyncStart, mode.hSyncEnd, mode.hTotal}},
+      {"v", QJsonArray{mode.vDisplay, mode.vSyncStart, mode.vSyncEnd, mode.vTotal}},
+      {"hsyncPositive", mode.hSyncPositive},
+      {"vsyncPositive", mode.vSyncPositive},
+    };
+  }
+
+  Modeline modeFromJson(const QJsonObject &json)
+  {
+    Modeline mode;
+    mode.name = json.value("name").toString();
+    mode.clockMHz = json.value("clock").toDouble();
+    const QJsonArray h = json.value("h").toArray();
+    const QJsonArray v = json.value("v").toArray();
+    if (h.size() == 4 && v.size() == 4)
+    {
+      mode.hDisplay = h.at(0).toInt();
+      mode.hSyncStart = h.at(1).toInt();
+      mode.hSyncEnd = h.at(2).toInt();
+      mode.hTotal = h.at(3).toInt();
+      mode.vDisplay = v.at(0).toInt();
+      mode.vSyncStart = v.at(1).toInt();
+      mode.vSyncEnd = v.at(2).toInt();
+      mode.vTotal = v.at(3).toInt();
+    }
+    mode.hSyncPositive = json.value("hsyncPositive").toBool();
+    mode.vSyncPositive = json.value("vsyncPositive").toBool(true);
+    return mode;
+  }
+
+  // Names of the input devices by id, from one "xinput list --short" call,
+  // which needs no udev lookups.
+  QHash<int, QString> readDeviceNames()
+  {
+    QHash<int, QString> names;
+    QProcess proc;
+    if (!runTracedProcess(proc, "xinput list", "xinput", {"list", "--short"}))
+    {
+      qWarning() << "xinput timed out or failed.";
+      return names;
+    }
+    static const QRegularExpression reDevice(R"(^(.*\S)\s+id=(\d+)\s)");
+    for (const QByteArray &lineBA : proc.readAllStandardOutput().split('\n'))
+    {
+      QString line = QString::fromLocal8Bit(lineBA);
+      line.remove(QRegularExpression("[⎡⎜⎣↳]"));
+      const QRegularExpressionMatch m = reDevice.match(line.trimmed());
+      if (m.hasMatch())
+        names.insert(m.captured(2).toInt(), m.captured(1).trimmed());
+    }
+    return names;
+  }
+
+  // Reads the matrices of all devices with one "xinput list-props" call.
+  QHash<int, QList<double>> readTouchMatrices(const QList<XInputDevice> &devices)
+  {
+    QHash<int, QList<double>> matrices;
+    QStringList arguments{"list-props"};
+    for (const XInputDevice &dev : devices)
+      arguments << QString::number(dev.id);
+    QProcess proc;
+    if (!runTracedProcess(proc, "xinput list-props", "xinput", arguments))
+    {
+      qWarning() << "xinput list-props timed out or failed.";
+      return matrices;
+    }
+    // Each device starts with "Device 'name':"; the order is that of the arguments.
+    static const QRegularExpression reMatrix(R"(^\s*Coordinate Transformation Matrix \(\d+\):\s*(.*)$)");
+    int index = -1;
+    for (const QByteArray &lineBA : proc.readAllStandardOutput().split('\n'))
+    {
+      const QString line = QString::fromLocal8Bit(lineBA);
+      if (line.startsWith("Device '"))
+      {
+        ++index;
+        continue;
+      }
+      QRegularExpressionMatch m = reMatrix.match(line);
+      if (!m.hasMatch() || index < 0 || index >= devices.size())
+        continue;
+      QList<double> matrix;
+      for (const QString &value : m.captured(1).split(','))
+        matrix << value.trimmed().toDouble();
+      if (matrix.size() == 9)
+        matrices.insert(devices.at(index).id, matrix);
+    }
+    return matrices;
+  }
+}
+
+StateSnapshot StateSnapshot::capture()
+{
+  TraceScope scope("StateSnapshot::capture");
+  StateSnapshot snapshot;
+  QProcess proc;
+  // --current reports the configuration without probing the outputs.
+  if (!runTracedProcess(proc, "xrandr --current --verbose", "xrandr", {"--current", "--verbose"}))
+  {
+    qWarning() << "xrandr query timed out or failed.";
+    return snapshot;
+  }
+  const QByteArray output = proc.readAllStandardOutput();
+  snapshot.m_created = QDateTime::currentDateTime();
+  snapshot.m_screenSize = XRandrBackend::parseScreen(output).current;
+
+  const QHash<QString, XRandrMonitorInfo> monitors = XRandrBackend::parseMonitors(output);
+  for (auto it = monitors.constBegin(); it != monitors.constEnd(); ++it)
+  {
+    const XRandrMonitorInfo &info = it.value();
+    if (!info.connected && info.crtc < 0)
+      continue;
+    SnapshotOutput out;
+    out.name = it.key();
+    out.enabled = info.crtc >= 0 && !info.currentMode.name.isEmpty();
+    out.crtc = info.crtc;
+    out.mode = info.currentMode;
+    out.position = info.position;
+    // An emulated rotation is all in the transform; the CRTC itself is not rotated.
+    out.orientation = info.emulatedRotation ? Orientation::Normal : info.orientation;
+    out.reflection = info.emulatedRotation ? Reflection::None : info.reflection;
+    out.transform = info.transform;
+    out.primary = info.isPrimary;
+    for (const QString &property : XRandrBackend::tunableProperties())
+    {
+      if (info.properties.contains(property))
+        out.properties.insert(property, info.properties.value(property).value);
+    }
+    snapshot.m_outputs << out;
+  }
+  std::sort(snapshot.m_outputs.begin(), snapshot.m_outputs.end(),
+            [](const SnapshotOutput &a, const SnapshotOutput &b) { return a.name < b.name; });
+
+  const QList<XInputDevice> devices = XInputBackend::instance().devices();
+  if (!devices.isEmpty())
+  {
+    const QHash<int, QList<double>> matrices = readTouchMatrices(devices);
+    for (const XInputDevice &dev : devices)
+    {
+      if (matrices.contains(dev.id))
+        snapshot.m_touchDevices << SnapshotTouchDevice{dev.name, dev.idPath, dev.id, matrices.value(dev.id)};
+    }
+  }
+  scope.setArg("outputs", snapshot.m_outputs.size());
+  scope.setArg("touchDevices", snapshot.m_touchDevices.size());
+  return snapshot;
+}
+
+QString StateSnapshot::defaultPath()
+{
+  QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+  if (dir.isEmpty())
+    dir = QDir::tempPath();
+  return dir + "/snapshot.json";
+}
+
+bool StateSnapshot::save(const QString &path) const
+{
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  // Written to a temporary file and renamed, so a crash never leaves half a snapshot.
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "Cannot open snapshot file for writing:" << path;
+    return false;
+  }
+  file.write(QJsonDocument(toJson()).toJson());
+  return file.commit();
+}
+
+StateSnapshot StateSnapshot::load(const QString &path)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+    return {};
+  QJsonParseError error;
+  const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+  if (error.error != QJsonParseError::NoError)
+  {
+    qWarning() << "Cannot parse snapshot" << path << ":" << error.errorString();
+    return {};
+  }
+  return fromJson(document.object());
+}
+
+QJsonObject StateSnapshot::toJson() const
+{
+  QJsonArray outputs;
+  for (const SnapshotOutput &out : m_outputs)
+  {
+    QJsonObject obj{
+      {"name", out.name},
+      {"enabled", out.enabled},
+    };
+    if (out.enabled)
+    {
+      obj.insert("crtc", out.crtc);
+      obj.insert("mode", modeToJson(out.mode));
+      obj.insert("x", out.position.x());
+      obj.insert("y", out.position.y());
+      obj.insert("orientation", orientationToString(out.orientation));
+      obj.insert("reflection", reflectionToString(out.reflection));
+      obj.insert("transform", matrixToJson(out.transform));
+      obj.insert("primary", out.primary);
+    }
+    QJsonObject properties;
+    for (auto it = out.properties.constBegin(); it != out.properties.constEnd(); ++it)
+      properties.insert(it.key(), it.value());
+    obj.insert("properties", properties);
+    outputs.append(obj);
+  }
+  QJsonArray touchDevices;
+  for (const SnapshotTouchDevice &dev : m_touchDevices)
+  {
+    QJsonArray matrix;
+    for (double v : dev.matrix)
+      matrix.append(v);
+    touchDevices.append(QJsonObject{{"name", dev.name}, {"idPath", dev.idPath}, {"id", dev.id}, {"matrix", matrix}});
+  }
+  return {
+    {"created", m_created.toString(Qt::ISODate)},
+    {"width", m_screenSize.width()},
+    {"height", m_screenSize.height()},
+    {"outputs", outputs},
+    {"touchDevices", touchDevices},
+  };
+}
+
+StateSnapshot StateSnapshot::fromJson(const QJsonObject &json)
+{
+  StateSnapshot snapshot;
+  snapshot.m_created = QDateTime::fromString(json.value("created").toString(), Qt::ISODate);
+  snapshot.m_screenSize = QSize(json.value("width").toInt(), json.value("height").toInt());
+  for (const QJsonValue &value : json.value("outputs").toArray())
+  {
+    const QJsonObject obj = value.toObject();
+    SnapshotOutput out;
+    out.name = obj.value("name").toString();
+    if (out.name.isEmpty())
+      continue;
+    out.enabled = obj.value("enabled").toBool();
+    out.crtc = obj.value("crtc").toInt(-1);
+    out.mode = modeFromJson(obj.value("mode").toObject());
+    out.position = QPoint(obj.value("x").toInt(), obj.value("y").toInt());
+    out.orientation = stringToOrientation(obj.value("orientation").toString());
+    out.reflection = stringToReflection(obj.value("reflection").toString());
+    out.transform = matrixFromJson(obj.value("transform").toArray());
+    out.primary = obj.value("primary").toBool();
+    const QJsonObject properties = obj.value("properties").toObject();
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+      out.properties.insert(it.key(), it.value().toString());
+    if (out.enabled && out.mode.name.isEmpty())
+      continue;
+    snapshot.m_outputs << out;
+  }
+  for (const QJsonValue &value : json.value("touchDevices").toArray())
+  {
+    const QJsonObject obj = value.toObject();
+    SnapshotTouchDevice dev;
+    dev.name = obj.value("name").toString();
+    dev.idPath = obj.value("idPath").toString();
+    dev.id = obj.value("id").toInt(-1);
+    for (const QJsonValue &v : obj.value("matrix").toArray())
+      dev.matrix << v.toDouble();
+    if (dev.matrix.size() == 9)
+      snapshot.m_touchDevices << dev;
+  }
+  return snapshot;
+}
+
+QList<ApplyStage> StateSnapshot::restoreStages() const
+{
+  TraceScope scope("StateSnapshot::restoreStages");
+  // The cached state may predate the failed apply, and a full query would
+  // probe every output.
+  QHash<QString, XRandrMonitorInfo> monitors;
+  QProcess proc;
+  if (runTracedProcess(proc, "xrandr --current --verbose", "xrandr", {"--current", "--verbose"}))
+    monitors = XRandrBackend::parseMonitors(proc.readAllStandardOutput());
+  else
+    qWarning() << "xrandr query timed out or failed; restoring the saved outputs only.";
+
+  ApplyStage modesStage;
+  modesStage.name = QCoreApplication::translate("StateSnapshot", "Modes");
+  QSet<QString> createdModes;
+  QSet<QString> restored;
+  QStringList arguments;
+  if (m_screenSize.isValid())
+    arguments << "--fb" << QString("%1x%2").arg(m_screenSize.width()).arg(m_screenSize.height());
+  for (const SnapshotOutput &out : m_outputs)
+  {
+    // Outputs that disappeared since the snapshot cannot be restored.
+    if (!monitors.isEmpty() && !monitors.contains(out.name))
+      continue;
+    restored.insert(out.name);
+    arguments << "--output" << out.name;
+    if (!out.enabled)
+    {
+      arguments << "--off";
+      continue;
+    }
+    if (isUserMode(out.mode.name) && out.mode.hTotal > 0)
+    {
+      // Recreating an existing mode fails, which is fine.
+      if (!createdModes.contains(out.mode.name))
+      {
+        createdModes.insert(out.mode.name);
+        modesStage.commands << ApplyCommand{"xrandr", QStringList() << "--newmode" << out.mode.name
+                                                                   << out.mode.timingArguments(), true};
+      }
+      modesStage.commands << ApplyCommand{"xrandr", {"--addmode", out.name, out.mode.name}, true};
+    }
+    if (out.crtc >= 0)
+      arguments << "--crtc" << QString::number(out.crtc);
+    arguments << "--mode" << out.mode.name;
+    // Several modes can share a name; the refresh rate picks the right one.
+    if (out.mode.refreshRate() > 0)
+      arguments << "--rate" << QString::number(out.mode.refreshRate(), 'f', 2);
+    arguments << "--pos" << QString("%1x%2").arg(out.position.x()).arg(out.position.y())
+              << "--rotate" << orientationToString(out.orientation)
+              << "--reflect" << reflectionToString(out.reflection)
+              << "--transform" << matrixArgument(out.transform);
+    if (out.primary)
+      arguments << "--primary";
+    for (auto it = out.properties.constBegin(); it != out.properties.constEnd(); ++it)
+      arguments << "--set" << it.key() << it.value();
+  }
+  // Outputs the new layout switched on that were not there before.
+  for (auto it = monitors.constBegin(); it != monitors.constEnd(); ++it)
+  {
+    if (!restored.contains(it.key()) && it->crtc >= 0)
+      arguments << "--output" << it.key() << "--off";
+  }
+
+  ApplyStage outputsStage;
+  outputsStage.name = QCoreApplication::translate("StateSnapshot", "Outputs");
+  // xrandr sends everything as one request sequence under a server grab, so
+  // the X server never shows a mix of the old and the new layout.
+  if (!restored.isEmpty())
+    outputsStage.commands << ApplyCommand{"xrandr", arguments, false};
+
+  ApplyStage touchStage;
+  touchStage.name = QCoreApplication::translate("StateSnapshot", "Touch");
+  if (!m_touchDevices.isEmpty())
+  {
+    // Device ids change when devices are replugged. Only then are the
+    // devices scanned to find them by path and name, which is slow.
+    const QHash<int, QString> names = readDeviceNames();
+    QList<XInputDevice> devices;
+    bool scanned = false;
+    for (const SnapshotTouchDevice &saved : m_touchDevices)
+    {
+      QList<int> ids;
+      if (saved.id >= 0 && names.value(saved.id) == saved.name)
+      {
+        ids << saved.id;
+      }
+      else
+      {
+        if (!scanned)
+        {
+          devices = XInputBackend::instance().devices();
+          scanned = true;
+        }
+        for (const XInputDevice &dev : std::as_const(devices))
+        {
+          if (dev.idPath == saved.idPath && dev.name == saved.name)
+            ids << dev.id;
+        }
+      }
+      for (int id : std::as_const(ids))
+      {
+        QStringList setProp{"set-prop", QString::number(id), kMatrixProperty};
+        for (double v : saved.matrix)
+          setProp << QString::number(v, 'g', 10);
+        touchStage.commands << ApplyCommand{"xinput", setProp, true};
+      }
+    }
+  }
+  return {modesStage, outputsStage, touchStage};
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QtCore>
+#include <QTransform>
+#include "applypipeline.h"
+#include "modeline.h"
+#include "orientation.h"
+
+struct SnapshotOutput
+{
+  QString name;
+  // Off outputs are switched off again on restore.
+  bool enabled = false;
+  int crtc = -1;
+  Modeline mode;
+  QPoint position;
+  Orientation orientation = Orientation::Normal;
+  Reflection reflection = Reflection::None;
+  QTransform transform;
+  bool primary = false;
+  QMap<QString, QString> properties;
+};
+
+struct SnapshotTouchDevice
+{
+  QString name;
+  QString idPath;
+  // X input device id at capture; the path and name find the device again
+  // when the id was given to another device meanwhile.
+  int id = -1;
+  // Coordinate Transformation Matrix, row by row.
+  QList<double> matrix;
+};
+
+// The complete RandR configuration (modes with their timings, CRTC
+// assignment, positions, rotations, transforms, primary and the tunable
+// output properties) plus the touch matrices, as they were at one moment.
+// Capturing reads the state with --current, so no output is probed.
+class StateSnapshot
+{
+public:
+  static StateSnapshot capture();
+  static QString defaultPath();
+  static StateSnapshot load(const QString &path);
+
+  bool isValid() const { return !m_outputs.isEmpty(); }
+  QDateTime created() const { return m_created; }
+  const QList<SnapshotOutput> &outputs() const { return m_outputs; }
+  bool save(const QString &path) const;
+
+  // Restores the RandR state with a single xrandr call, which the X server
+  // applies as one transaction, and then sets the touch matrices. Reads the
+  // live state with --current, so nothing is probed and a failed apply is
+  // seen as it left the outputs.
+  QList<ApplyStage> restoreStages() const;
+
+  QJsonObject toJson() const;
+  static StateSnapshot fromJson(const QJsonObject &json);
+
+private:
+  QDateTime m_created;
+  QSize m_screenSize;
+  QList<SnapshotOutput> m_outputs;
+  QList<SnapshotTouchDevice> m_touchDevices;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QtTest>
+#include "xrandrbackend.h"
+
+// Captured "xrandr --current --verbose" of a laptop panel cloned to HDMI-1,
+// a 5K display driven as two DisplayPort tiles and a portrait monitor whose
+// rotation is done with a transform.
+inline QByteArray readFixture()
+{
+  QFile file(QFINDTESTDATA("data/xrandr-current-verbose.txt"));
+  if (!file.open(QIODevice::ReadOnly))
+    return QByteArray();
+  return file.readAll();
+}
+
+inline XRandrMonitorConfig monitorConfig(const QString &name, const QSize &resolution, const QPoint &position)
+{
+  XRandrMonitorConfig cfg;
+  cfg.screenName = name;
+  cfg.resolution = resolution;
+  cfg.position = position;
+  cfg.orientation = "normal";
+  return cfg;
+}
@@ -0,0 +1,48 @@
+#include <QtTest>
+#include "testdata.h"
+
+class TestChangedConfigs : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void unchanged();
+  void changedOutputsOnly();
+};
+
+void TestChangedConfigs::initTestCase()
+{
+  const QByteArray fixture = readFixture();
+  QVERIFY(!fixture.isEmpty());
+  // changedConfigs() compares with the state of the backend.
+  XRandrBackend::instance().parseQueryOutput(fixture);
+}
+
+void TestChangedConfigs::unchanged()
+{
+  QList<XRandrMonitorConfig> configs{monitorConfig("eDP-1", QSize(1920, 1080), QPoint(0, 0)),
+                                     monitorConfig("HDMI-1", QSize(1920, 1080), QPoint(0, 0))};
+  configs[0].isPrimary = true;
+  QVERIFY(XRandrBackend::instance().changedConfigs(configs).isEmpty());
+  QVERIFY(XRandrBackend::instance().matchesCurrentState(configs));
+}
+
+void TestChangedConfigs::changedOutputsOnly()
+{
+  QList<XRandrMonitorConfig> configs{monitorConfig("eDP-1", QSize(1920, 1080), QPoint(0, 0)),
+                                     monitorConfig("HDMI-1", QSize(1280, 720), QPoint(1920, 0)),
+                                     monitorConfig("DP-3", QSize(1920, 1080), QPoint(3200, 0))};
+  configs[0].isPrimary = true;
+  // A new mode and position, and an output that is not connected.
+  const QList<XRandrMonitorConfig> changed = XRandrBackend::instance().changedConfigs(configs);
+  QCOMPARE(changed.size(), 2);
+  QCOMPARE(changed.at(0).screenName, QString("HDMI-1"));
+  QCOMPARE(changed.at(1).screenName, QString("DP-3"));
+
+  configs[0].isPrimary = false;
+  QCOMPARE(XRandrBackend::instance().changedConfigs(configs).size(), 3);
+}
+
+QTEST_GUILESS_MAIN(TestChangedConfigs)
+#include "tst_changedconfigs.moc"
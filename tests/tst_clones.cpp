@@ -0,0 +1,150 @@
+#include <QtTest>
+#include "testdata.h"
+
+class TestClones : public QObject
+{
+  Q_OBJECT
+
+private:
+  QHash<QString, XRandrMonitorInfo> m_monitors;
+
+  QList<XRandrMonitorConfig> cloneConfigs(const QSize &cloneResolution) const;
+
+private slots:
+  void initTestCase();
+  void parseModes();
+  void sharesModeXid();
+  void withoutCommonXid();
+  void scalesOtherSize();
+  void keepsCrtcsInUse();
+  void changedModeAndCrtc();
+  void scriptNamesSharedMode();
+};
+
+QList<XRandrMonitorConfig> TestClones::cloneConfigs(const QSize &cloneResolution) const
+{
+  QList<XRandrMonitorConfig> configs{monitorConfig("eDP-1", QSize(1920, 1080), QPoint(0, 0)),
+                                     monitorConfig("HDMI-1", cloneResolution, QPoint(500, 500))};
+  configs[0].isPrimary = true;
+  configs[1].cloneOf = "eDP-1";
+  return configs;
+}
+
+void TestClones::initTestCase()
+{
+  const QByteArray fixture = readFixture();
+  QVERIFY(!fixture.isEmpty());
+  m_monitors = XRandrBackend::parseMonitors(fixture);
+  XRandrBackend::instance().parseQueryOutput(fixture);
+}
+
+void TestClones::parseModes()
+{
+  QCOMPARE(m_monitors.size(), 6);
+  QVERIFY(!m_monitors.value("DP-3").connected);
+
+  const XRandrMonitorInfo edp = m_monitors.value("eDP-1");
+  QCOMPARE(edp.crtc, 0);
+  QCOMPARE(edp.crtcs, QList<int>({0, 1, 2, 3}));
+  QCOMPARE(edp.clones, QStringList{"HDMI-1"});
+  QCOMPARE(edp.allResolutions, QList<QSize>({QSize(1920, 1080), QSize(1280, 1024)}));
+
+  // Both 1920x1080 modes are listed, each with its own XID and timings.
+  QCOMPARE(edp.modes.size(), 3);
+  QCOMPARE(edp.modes.at(0).id, 0x48u);
+  QVERIFY(edp.modes.at(0).current);
+  QVERIFY(edp.modes.at(0).preferred);
+  QCOMPARE(edp.modes.at(1).id, 0x49u);
+  QCOMPARE(edp.modes.at(1).modeline.hTotal, 2576);
+  QCOMPARE(edp.modes.at(1).modeline.vTotal, 1120);
+  QVERIFY(!edp.modes.at(1).modeline.hSyncPositive);
+  QVERIFY(edp.modes.at(1).modeline.vSyncPositive);
+  QCOMPARE(edp.currentMode.clockMHz, 138.5);
+  QCOMPARE(edp.currentMode.hSyncStart, 1968);
+  QCOMPARE(edp.currentMode.vTotal, 1111);
+
+  const XRandrMonitorInfo hdmi = m_monitors.value("HDMI-1");
+  QCOMPARE(hdmi.crtc, 0);
+  QCOMPARE(hdmi.preferredMode.clockMHz, 148.5);
+  QCOMPARE(hdmi.currentMode.clockMHz, 138.5);
+}
+
+void TestClones::sharesModeXid()
+{
+  QList<XRandrMonitorConfig> configs = cloneConfigs(QSize(1920, 1080));
+  XRandrBackend::planClones(configs, m_monitors);
+  QCOMPARE(configs.at(1).position, QPoint(0, 0));
+  QCOMPARE(configs.at(0).crtc, 0);
+  QCOMPARE(configs.at(1).crtc, 0);
+  // 0x48 is the only 1920x1080 mode object both outputs list.
+  QCOMPARE(configs.at(0).modeId, 0x48u);
+  QCOMPARE(configs.at(1).modeId, 0x48u);
+  QVERIFY(!configs.at(1).scaleFrom.isValid());
+}
+
+void TestClones::withoutCommonXid()
+{
+  QHash<QString, XRandrMonitorInfo> monitors = m_monitors;
+  monitors["HDMI-1"].modes.removeIf([](const XRandrMode &mode) { return mode.id == 0x48; });
+  QList<XRandrMonitorConfig> configs = cloneConfigs(QSize(1920, 1080));
+  XRandrBackend::planClones(configs, monitors);
+  // Same size, other timing: a CRTC of its own with --same-as.
+  QCOMPARE(configs.at(0).crtc, -1);
+  QCOMPARE(configs.at(1).crtc, -1);
+  QCOMPARE(configs.at(0).modeId, 0u);
+  QCOMPARE(configs.at(1).modeId, 0u);
+  QVERIFY(!configs.at(1).scaleFrom.isValid());
+}
+
+void TestClones::scalesOtherSize()
+{
+  QList<XRandrMonitorConfig> configs = cloneConfigs(QSize(1280, 720));
+  XRandrBackend::planClones(configs, m_monitors);
+  QCOMPARE(configs.at(1).crtc, -1);
+  QCOMPARE(configs.at(1).scaleFrom, QSize(1920, 1080));
+}
+
+void TestClones::keepsCrtcsInUse()
+{
+  QHash<QString, XRandrMonitorInfo> monitors = m_monitors;
+  // HDMI-1 could only share CRTC 1, which DP-1 drives.
+  monitors["HDMI-1"].crtcs = {1};
+  QList<XRandrMonitorConfig> configs = cloneConfigs(QSize(1920, 1080));
+  XRandrBackend::planClones(configs, monitors);
+  QCOMPARE(configs.at(0).crtc, -1);
+  QCOMPARE(configs.at(1).crtc, -1);
+  QCOMPARE(configs.at(1).modeId, 0u);
+}
+
+void TestClones::changedModeAndCrtc()
+{
+  QList<XRandrMonitorConfig> configs = cloneConfigs(QSize(1920, 1080));
+  XRandrBackend::planClones(configs, m_monitors);
+  const XRandrBackend &xrandr = XRandrBackend::instance();
+  QVERIFY(xrandr.changedConfigs(configs).isEmpty());
+
+  // The other 1920x1080 mode of the panel.
+  QList<XRandrMonitorConfig> otherMode = configs;
+  otherMode[0].modeId = 0x49;
+  QCOMPARE(xrandr.changedConfigs(otherMode).size(), 1);
+
+  QList<XRandrMonitorConfig> otherCrtc = configs;
+  otherCrtc[1].crtc = 1;
+  QCOMPARE(xrandr.changedConfigs(otherCrtc).size(), 1);
+}
+
+void TestClones::scriptNamesSharedMode()
+{
+  QList<XRandrMonitorConfig> configs = cloneConfigs(QSize(1920, 1080));
+  XRandrBackend::planClones(configs, m_monitors);
+  const XRandrBackend &xrandr = XRandrBackend::instance();
+  // Apply uses the XID of the running server ...
+  QVERIFY(xrandr.outputArguments(configs).join(' ').contains("--crtc 0 --mode 0x48 "));
+  // ... a script the name and refresh rate, since XIDs change with the server.
+  const QString script = xrandr.buildScript(configs);
+  QVERIFY(!script.contains("0x48"));
+  QCOMPARE(script.count("--crtc 0 --mode 1920x1080 --rate 59.93 "), 2);
+}
+
+QTEST_GUILESS_MAIN(TestClones)
+#include "tst_clones.moc"
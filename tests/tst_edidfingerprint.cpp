@@ -0,0 +1,31 @@
+#include <QtTest>
+#include "testdata.h"
+
+class TestEdidFingerprint : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void parseFingerprint();
+  void hashesHexText();
+};
+
+void TestEdidFingerprint::parseFingerprint()
+{
+  const QHash<QString, XRandrMonitorInfo> monitors = XRandrBackend::parseMonitors(readFixture());
+  // printf '%s' <EDID hex> | sha256sum
+  QCOMPARE(monitors.value("eDP-1").edidFingerprint,
+           QString("8f3241f1edc045342d539facb23a49b9574662000313400976e633ad379c2b8e"));
+  QVERIFY(monitors.value("HDMI-1").edidFingerprint.isEmpty());
+}
+
+void TestEdidFingerprint::hashesHexText()
+{
+  const QByteArray edid = QByteArray::fromHex("00ffffffffffff0030e4");
+  QCOMPARE(XRandrBackend::edidFingerprint(edid),
+           QString::fromLatin1(QCryptographicHash::hash("00ffffffffffff0030e4", QCryptographicHash::Sha256).toHex()));
+  QVERIFY(XRandrBackend::edidFingerprint(QByteArray()).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestEdidFingerprint)
+#include "tst_edidfingerprint.moc"
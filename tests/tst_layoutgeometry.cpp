@@ -0,0 +1,40 @@
+#include <QtTest>
+#include "layoutgeometry.h"
+
+class TestLayoutGeometry : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void compactLayout_data();
+  void compactLayout();
+};
+
+void TestLayoutGeometry::compactLayout_data()
+{
+  QTest::addColumn<QList<QRect>>("rects");
+  QTest::addColumn<QList<QPoint>>("expected");
+
+  QTest::newRow("gap in a row")
+      << QList<QRect>{{100, 50, 1920, 1080}, {2500, 50, 1920, 1080}}
+      << QList<QPoint>{{0, 0}, {1920, 0}};
+  QTest::newRow("gap in a column")
+      << QList<QRect>{{0, 0, 1920, 1080}, {0, 1200, 1920, 1080}}
+      << QList<QPoint>{{0, 0}, {0, 1080}};
+  QTest::newRow("overlap")
+      << QList<QRect>{{0, 0, 1920, 1080}, {1000, 0, 1920, 1080}}
+      << QList<QPoint>{{0, 0}, {1920, 0}};
+  QTest::newRow("input order")
+      << QList<QRect>{{3000, 0, 1280, 1024}, {500, 0, 1920, 1080}}
+      << QList<QPoint>{{1920, 0}, {0, 0}};
+}
+
+void TestLayoutGeometry::compactLayout()
+{
+  QFETCH(QList<QRect>, rects);
+  QFETCH(QList<QPoint>, expected);
+  QCOMPARE(::compactLayout(rects), expected);
+}
+
+QTEST_GUILESS_MAIN(TestLayoutGeometry)
+#include "tst_layoutgeometry.moc"
@@ -0,0 +1,106 @@
+#include <QtTest>
+#include "layoutvalidation.h"
+#include "testdata.h"
+
+namespace
+{
+  LayoutOutput layoutOutput(const QString &name, const QSize &mode, const QPoint &position)
+  {
+    LayoutOutput out;
+    out.name = name;
+    out.mode = mode;
+    out.position = position;
+    out.availableModes << mode;
+    return out;
+  }
+
+  OutputConstraints crtcConstraints(const QList<int> &crtcs, const QStringList &clones = {})
+  {
+    OutputConstraints oc;
+    oc.crtcs = crtcs;
+    oc.clones = clones;
+    return oc;
+  }
+}
+
+class TestLayoutValidation : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void parseScreen();
+  void parseEdidRange();
+  void crtcMatching();
+  void crtcShortage();
+  void clonesShareCrtc();
+};
+
+void TestLayoutValidation::parseScreen()
+{
+  const XRandrScreenInfo screen = XRandrBackend::parseScreen(readFixture());
+  QCOMPARE(screen.minimum, QSize(320, 200));
+  QCOMPARE(screen.current, QSize(8120, 2880));
+  QCOMPARE(screen.maximum, QSize(16384, 16384));
+}
+
+void TestLayoutValidation::parseEdidRange()
+{
+  const QHash<QString, XRandrMonitorInfo> monitors = XRandrBackend::parseMonitors(readFixture());
+  const XRandrTimingRange range = monitors.value("eDP-1").timingRange;
+  QVERIFY(range.valid);
+  QCOMPARE(range.minVerticalHz, 56);
+  QCOMPARE(range.maxVerticalHz, 76);
+  QCOMPARE(range.minHorizontalKHz, 30);
+  QCOMPARE(range.maxHorizontalKHz, 83);
+  QCOMPARE(range.maxPixelClockMHz, 170);
+  QVERIFY(!monitors.value("HDMI-1").timingRange.valid);
+}
+
+void TestLayoutValidation::crtcMatching()
+{
+  // A greedy assignment gives CRTC 0 to A and leaves nothing for B.
+  LayoutConstraints constraints;
+  constraints.crtcs = {0, 1};
+  constraints.outputs.insert("A", crtcConstraints({0, 1}));
+  constraints.outputs.insert("B", crtcConstraints({0}));
+  const QList<LayoutOutput> outputs{layoutOutput("A", QSize(1920, 1080), QPoint(0, 0)),
+                                    layoutOutput("B", QSize(1920, 1080), QPoint(1920, 0))};
+  QVERIFY(validateLayout(outputs, constraints).isEmpty());
+}
+
+void TestLayoutValidation::crtcShortage()
+{
+  LayoutConstraints constraints;
+  constraints.crtcs = {0, 1};
+  for (const QString &name : {"A", "B", "C"})
+    constraints.outputs.insert(name, crtcConstraints({0, 1}));
+  const QList<LayoutOutput> outputs{layoutOutput("A", QSize(1920, 1080), QPoint(0, 0)),
+                                    layoutOutput("B", QSize(1920, 1080), QPoint(1920, 0)),
+                                    layoutOutput("C", QSize(1920, 1080), QPoint(3840, 0))};
+  const QList<LayoutIssue> issues = validateLayout(outputs, constraints);
+  QCOMPARE(issues.size(), 1);
+  QCOMPARE(issues.at(0).output, 2);
+}
+
+void TestLayoutValidation::clonesShareCrtc()
+{
+  LayoutConstraints constraints;
+  constraints.crtcs = {0, 1};
+  constraints.outputs.insert("A", crtcConstraints({0, 1}, {"B"}));
+  constraints.outputs.insert("B", crtcConstraints({0, 1}, {"A"}));
+  constraints.outputs.insert("C", crtcConstraints({0, 1}));
+  const QList<LayoutOutput> outputs{layoutOutput("C", QSize(1920, 1080), QPoint(1920, 0)),
+                                    layoutOutput("A", QSize(1920, 1080), QPoint(0, 0)),
+                                    layoutOutput("B", QSize(1920, 1080), QPoint(0, 0))};
+  QVERIFY(validateLayout(outputs, constraints).isEmpty());
+
+  // Without RandR's consent the same picture still needs two CRTCs.
+  constraints.outputs["B"].clones.clear();
+  const QList<LayoutIssue> issues = validateLayout(outputs, constraints);
+  QCOMPARE(issues.size(), 1);
+  QCOMPARE(issues.at(0).output, 2);
+  QVERIFY(issues.at(0).message.endsWith("It cannot be cloned with A."));
+}
+
+QTEST_GUILESS_MAIN(TestLayoutValidation)
+#include "tst_layoutvalidation.moc"
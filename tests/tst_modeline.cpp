@@ -0,0 +1,47 @@
+#include <QtTest>
+#include "modeline.h"
+
+class TestModeline : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void cvtModeline_data();
+  void cvtModeline();
+};
+
+void TestModeline::cvtModeline_data()
+{
+  QTest::addColumn<QSize>("size");
+  QTest::addColumn<bool>("reducedBlanking");
+  QTest::addColumn<QString>("name");
+  QTest::addColumn<QString>("timings");
+
+  // The mode lines printed by "cvt 1920 1080", "cvt -r 1920 1080" etc.
+  QTest::newRow("1920x1080") << QSize(1920, 1080) << false << "1920x1080_60.00"
+      << "173.00 1920 2048 2248 2576 1080 1083 1088 1120 -hsync +vsync";
+  QTest::newRow("1920x1080 reduced") << QSize(1920, 1080) << true << "1920x1080R"
+      << "138.50 1920 1968 2000 2080 1080 1083 1088 1111 +hsync -vsync";
+  QTest::newRow("1280x1024") << QSize(1280, 1024) << false << "1280x1024_60.00"
+      << "109.00 1280 1368 1496 1712 1024 1027 1034 1063 -hsync +vsync";
+  QTest::newRow("800x600") << QSize(800, 600) << false << "800x600_60.00"
+      << "38.25 800 832 912 1024 600 603 607 624 -hsync +vsync";
+  QTest::newRow("2560x1440") << QSize(2560, 1440) << false << "2560x1440_60.00"
+      << "312.25 2560 2752 3024 3488 1440 1443 1448 1493 -hsync +vsync";
+  QTest::newRow("3840x2160") << QSize(3840, 2160) << false << "3840x2160_60.00"
+      << "712.75 3840 4160 4576 5312 2160 2163 2168 2237 -hsync +vsync";
+}
+
+void TestModeline::cvtModeline()
+{
+  QFETCH(QSize, size);
+  QFETCH(bool, reducedBlanking);
+  QFETCH(QString, name);
+  QFETCH(QString, timings);
+  const Modeline mode = ::cvtModeline(size.width(), size.height(), 60.0, reducedBlanking);
+  QCOMPARE(mode.name, name);
+  QCOMPARE(mode.timingArguments().join(' '), timings);
+}
+
+QTEST_GUILESS_MAIN(TestModeline)
+#include "tst_modeline.moc"
@@ -0,0 +1,49 @@
+#include <QtTest>
+#include "testdata.h"
+
+class TestOutputProperties : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void parseProperties();
+  void changedProperties();
+};
+
+void TestOutputProperties::initTestCase()
+{
+  const QByteArray fixture = readFixture();
+  QVERIFY(!fixture.isEmpty());
+  XRandrBackend::instance().parseQueryOutput(fixture);
+}
+
+void TestOutputProperties::parseProperties()
+{
+  const XRandrMonitorInfo edp = XRandrBackend::parseMonitors(readFixture()).value("eDP-1");
+  QCOMPARE(edp.properties.value("max bpc").value, QString("12"));
+  QVERIFY(edp.properties.value("max bpc").hasRange);
+  QCOMPARE(edp.properties.value("max bpc").rangeMin, 6);
+  QCOMPARE(edp.properties.value("max bpc").rangeMax, 12);
+  QCOMPARE(edp.properties.value("Broadcast RGB").supported,
+           QStringList({"Automatic", "Full", "Limited 16:235"}));
+  // Only the tunable properties are kept.
+  QVERIFY(!edp.properties.contains("non-desktop"));
+}
+
+void TestOutputProperties::changedProperties()
+{
+  XRandrMonitorConfig edp = monitorConfig("eDP-1", QSize(1920, 1080), QPoint(0, 0));
+  edp.isPrimary = true;
+  edp.properties.insert("max bpc", "12");
+  const XRandrBackend &xrandr = XRandrBackend::instance();
+  QVERIFY(xrandr.changedConfigs({edp}).isEmpty());
+  QVERIFY(xrandr.matchesCurrentState({edp}));
+
+  edp.properties.insert("max bpc", "10");
+  QCOMPARE(xrandr.changedConfigs({edp}).size(), 1);
+  QVERIFY(!xrandr.matchesCurrentState({edp}));
+}
+
+QTEST_GUILESS_MAIN(TestOutputProperties)
+#include "tst_outputproperties.moc"
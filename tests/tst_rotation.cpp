@@ -0,0 +1,96 @@
+#include <QtTest>
+#include "testdata.h"
+
+namespace
+{
+  // Applies a matrix the way RandR does, for column vectors.
+  QPointF mapColumn(const QTransform &t, const QPointF &p)
+  {
+    const qreal w = t.m31() * p.x() + t.m32() * p.y() + t.m33();
+    return QPointF((t.m11() * p.x() + t.m12() * p.y() + t.m13()) / w,
+                   (t.m21() * p.x() + t.m22() * p.y() + t.m23()) / w);
+  }
+}
+
+class TestRotation : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void rotationTransform_data();
+  void rotationTransform();
+  void parseEmulatedRotation();
+  void changedEmulatedRotation();
+};
+
+void TestRotation::initTestCase()
+{
+  const QByteArray fixture = readFixture();
+  QVERIFY(!fixture.isEmpty());
+  XRandrBackend::instance().parseQueryOutput(fixture);
+}
+
+void TestRotation::rotationTransform_data()
+{
+  QTest::addColumn<Orientation>("orientation");
+  QTest::addColumn<Reflection>("reflection");
+  QTest::addColumn<QPointF>("topLeft");
+  QTest::addColumn<QPointF>("bottomRight");
+
+  // Where the corners of a 1920x1080 mode end up in the framebuffer.
+  QTest::newRow("normal") << Orientation::Normal << Reflection::None << QPointF(0, 0) << QPointF(1920, 1080);
+  QTest::newRow("left") << Orientation::Left << Reflection::None << QPointF(1080, 0) << QPointF(0, 1920);
+  QTest::newRow("inverted") << Orientation::Inverted << Reflection::None << QPointF(1920, 1080) << QPointF(0, 0);
+  QTest::newRow("right") << Orientation::Right << Reflection::None << QPointF(0, 1920) << QPointF(1080, 0);
+  QTest::newRow("normal x") << Orientation::Normal << Reflection::X << QPointF(1920, 0) << QPointF(0, 1080);
+  QTest::newRow("normal xy") << Orientation::Normal << Reflection::XY << QPointF(1920, 1080) << QPointF(0, 0);
+  // The reflection follows the rotation, in the rotated framebuffer.
+  QTest::newRow("left x") << Orientation::Left << Reflection::X << QPointF(0, 0) << QPointF(1080, 1920);
+  QTest::newRow("right y") << Orientation::Right << Reflection::Y << QPointF(0, 0) << QPointF(1080, 1920);
+}
+
+void TestRotation::rotationTransform()
+{
+  QFETCH(Orientation, orientation);
+  QFETCH(Reflection, reflection);
+  QFETCH(QPointF, topLeft);
+  QFETCH(QPointF, bottomRight);
+  const QTransform t = XRandrBackend::rotationTransform(QSize(1920, 1080), orientation, reflection);
+  QCOMPARE(mapColumn(t, QPointF(0, 0)), topLeft);
+  QCOMPARE(mapColumn(t, QPointF(1920, 1080)), bottomRight);
+}
+
+void TestRotation::parseEmulatedRotation()
+{
+  const QHash<QString, XRandrMonitorInfo> monitors = XRandrBackend::parseMonitors(readFixture());
+  QVERIFY(monitors.value("eDP-1").transform.isIdentity());
+  QVERIFY(!monitors.value("eDP-1").emulatedRotation);
+  QCOMPARE(monitors.value("eDP-1").rotations.size(), 4);
+  QVERIFY(monitors.value("eDP-1").canReflectX);
+
+  // The CRTC is not rotated; the transform is the one dpset sets for left.
+  const XRandrMonitorInfo portrait = monitors.value("HDMI-2");
+  QCOMPARE(portrait.transform.m13(), 1080.0);
+  QCOMPARE(portrait.transform.m21(), 1.0);
+  QVERIFY(portrait.emulatedRotation);
+  QCOMPARE(portrait.orientation, Orientation::Left);
+  QCOMPARE(portrait.reflection, Reflection::None);
+  QCOMPARE(portrait.currentResolution, QSize(1920, 1080));
+  QCOMPARE(portrait.position, QPoint(7040, 0));
+}
+
+void TestRotation::changedEmulatedRotation()
+{
+  XRandrMonitorConfig portrait = monitorConfig("HDMI-2", QSize(1920, 1080), QPoint(7040, 0));
+  portrait.orientation = "left";
+  portrait.emulatedRotation = true;
+  QVERIFY(XRandrBackend::instance().changedConfigs({portrait}).isEmpty());
+
+  // The same orientation done by the CRTC is a different configuration.
+  portrait.emulatedRotation = false;
+  QCOMPARE(XRandrBackend::instance().changedConfigs({portrait}).size(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestRotation)
+#include "tst_rotation.moc"
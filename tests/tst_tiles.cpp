@@ -0,0 +1,111 @@
+#include <QtTest>
+#include "layoutvalidation.h"
+#include "testdata.h"
+
+namespace
+{
+  LayoutOutput layoutOutput(const QString &name, const QSize &mode, const QPoint &position)
+  {
+    LayoutOutput out;
+    out.name = name;
+    out.mode = mode;
+    out.position = position;
+    out.availableModes << mode;
+    return out;
+  }
+
+  // The 5K display of the fixture, as the layout model merges its tiles.
+  LayoutOutput tiledOutput(const QPoint &position)
+  {
+    LayoutOutput out = layoutOutput("DP-1", QSize(5120, 2880), position);
+    out.tileGroup = 1;
+    out.tiles = {LayoutTile{"DP-1", QRect(0, 0, 2560, 2880), 60.0},
+                 LayoutTile{"DP-2", QRect(2560, 0, 2560, 2880), 60.0}};
+    return out;
+  }
+}
+
+class TestTiles : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void parseTiles();
+  void tilesNeedOwnCrtcs();
+  void changedTilesTogether();
+};
+
+void TestTiles::initTestCase()
+{
+  const QByteArray fixture = readFixture();
+  QVERIFY(!fixture.isEmpty());
+  XRandrBackend::instance().parseQueryOutput(fixture);
+}
+
+void TestTiles::parseTiles()
+{
+  const QHash<QString, XRandrMonitorInfo> monitors = XRandrBackend::parseMonitors(readFixture());
+  const XRandrTile left = monitors.value("DP-1").tile;
+  const XRandrTile right = monitors.value("DP-2").tile;
+  QVERIFY(left.isValid());
+  QVERIFY(right.isValid());
+  QCOMPARE(left.group, 1);
+  QCOMPARE(right.group, 1);
+  QCOMPARE(left.columns, 2);
+  QCOMPARE(left.rows, 1);
+  QCOMPARE(left.column, 0);
+  QCOMPARE(right.column, 1);
+  QCOMPARE(right.row, 0);
+  QCOMPARE(right.size, QSize(2560, 2880));
+  QVERIFY(!monitors.value("eDP-1").tile.isValid());
+}
+
+void TestTiles::tilesNeedOwnCrtcs()
+{
+  LayoutConstraints constraints;
+  constraints.crtcs = {0, 1};
+  for (const QString &name : {"DP-1", "DP-2", "HDMI-1"})
+  {
+    OutputConstraints oc;
+    oc.crtcs = {0, 1};
+    constraints.outputs.insert(name, oc);
+  }
+  QVERIFY(validateLayout({tiledOutput(QPoint(0, 0))}, constraints).isEmpty());
+
+  // Two tiles and one more output do not fit on two CRTCs.
+  const QList<LayoutIssue> issues =
+      validateLayout({tiledOutput(QPoint(0, 0)), layoutOutput("HDMI-1", QSize(1920, 1080), QPoint(5120, 0))}, constraints);
+  QCOMPARE(issues.size(), 1);
+  QCOMPARE(issues.at(0).output, 1);
+
+  // Neither tile finds a CRTC; the display gets one issue, not one per tile.
+  constraints.crtcs = {0};
+  for (OutputConstraints &oc : constraints.outputs)
+    oc.crtcs = {0};
+  const QList<LayoutIssue> ownerIssues =
+      validateLayout({layoutOutput("HDMI-1", QSize(1920, 1080), QPoint(0, 0)), tiledOutput(QPoint(1920, 0))}, constraints);
+  QCOMPARE(ownerIssues.size(), 1);
+  QCOMPARE(ownerIssues.at(0).output, 1);
+}
+
+void TestTiles::changedTilesTogether()
+{
+  QList<XRandrMonitorConfig> configs{monitorConfig("eDP-1", QSize(1920, 1080), QPoint(0, 0)),
+                                     monitorConfig("DP-1", QSize(2560, 2880), QPoint(1920, 0)),
+                                     monitorConfig("DP-2", QSize(2560, 2880), QPoint(4480, 0))};
+  configs[0].isPrimary = true;
+  configs[1].monitor = "DP-1";
+  configs[2].monitor = "DP-1";
+  QVERIFY(XRandrBackend::instance().changedConfigs(configs).isEmpty());
+
+  // A changed tile takes the other tiles of its display along.
+  configs[2].rate = 30.0;
+  const QList<XRandrMonitorConfig> changed = XRandrBackend::instance().changedConfigs(configs);
+  QCOMPARE(changed.size(), 2);
+  QCOMPARE(changed.at(0).screenName, QString("DP-1"));
+  QCOMPARE(changed.at(1).screenName, QString("DP-2"));
+}
+
+QTEST_GUILESS_MAIN(TestTiles)
+#include "tst_tiles.moc"
@@ -0,0 +1,202 @@
+#include "touchwatcher.h"
+#include "tracer.h"
+#include <QSocketNotifier>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XInput2.h>
+
+// Enable with QT_LOGGING_RULES="dpset.touch.info=true".
+Q_LOGGING_CATEGORY(lcTouch, "dpset.touch", QtWarningMsg)
+
+TouchWatcher::TouchWatcher(QObject *parent)
+:QObject(parent)
+{
+}
+
+TouchWatcher::~TouchWatcher()
+{
+  if (m_display)
+    XCloseDisplay(m_display);
+}
+
+bool TouchWatcher::start()
+{
+  if (m_display)
+    return true;
+  m_display = XOpenDisplay(nullptr);
+  if (!m_display)
+  {
+    qWarning() << "TouchWatcher: cannot open the X display.";
+    return false;
+  }
+
+  int event = 0;
+  int error = 0;
+  int major = 2;
+  int minor = 0;
+  if (!XQueryExtension(m_display, "XInputExtension", &m_xiOpcode, &event, &error)
+  ||  XIQueryVersion(m_display, &major, &minor) != Success)
+  {
+    qWarning() << "TouchWatcher: the X server does not support XInput 2.";
+    XCloseDisplay(m_display);
+    m_display = nullptr;
+    return false;
+  }
+  m_nodeAtom = XInternAtom(m_display, "Device Node", False);
+  m_matrixAtom = XInternAtom(m_display, "Coordinate Transformation Matrix", False);
+  m_floatAtom = XInternAtom(m_display, "FLOAT", False);
+
+  unsigned char bits[XIMaskLen(XI_LASTEVENT)] = {};
+  XISetMask(bits, XI_HierarchyChanged);
+  XIEventMask mask;
+  mask.deviceid = XIAllDevices;
+  mask.mask_len = sizeof(bits);
+  mask.mask = bits;
+  XISelectEvents(m_display, DefaultRootWindow(m_display), &mask, 1);
+  XFlush(m_display);
+
+  m_notifier = new QSocketNotifier(ConnectionNumber(m_display), QSocketNotifier::Read, this);
+  connect(m_notifier, &QSocketNotifier::activated, this, &TouchWatcher::processEvents);
+  applyToPresentDevices();
+  return true;
+}
+
+void TouchWatcher::setMappings(const QList<XInputDeviceConfig> &configs)
+{
+  m_mappings.clear();
+  for (const XInputDeviceConfig &config : configs)
+  {
+    if (config.idPath.isEmpty() || config.deviceName.isEmpty())
+      continue;
+    const QTransform T = XInputBackend::instance().screenTransform(config);
+    Mapping mapping;
+    mapping.outputName = config.outputName;
+    const qreal values[9] = {T.m11(), T.m12(), T.m13(), T.m21(), T.m22(), T.m23(), T.m31(), T.m32(), T.m33()};
+    for (int i = 0; i < 9; ++i)
+      mapping.matrix[i] = float(values[i]);
+    m_mappings.insert(mappingKey(config.idPath, config.deviceName), mapping);
+  }
+  applyToPresentDevices();
+}
+
+void TouchWatcher::processEvents()
+{
+  while (XPending(m_display))
+  {
+    XEvent event;
+    XNextEvent(m_display, &event);
+    XGenericEventCookie *cookie = &event.xcookie;
+    if (cookie->type != GenericEvent || cookie->extension != m_xiOpcode
+    ||  !XGetEventData(m_display, cookie))
+    {
+      continue;
+    }
+    if (cookie->evtype == XI_HierarchyChanged)
+    {
+      const auto *hierarchy = static_cast<XIHierarchyEvent *>(cookie->data);
+      for (int i = 0; i < hierarchy->num_info; ++i)
+      {
+        if (hierarchy->info[i].flags & XIDeviceEnabled)
+          deviceEnabled(hierarchy->info[i].deviceid);
+      }
+      if (hierarchy->flags & (XISlaveAdded | XISlaveRemoved | XIDeviceEnabled | XIDeviceDisabled))
+        emit devicesChanged();
+    }
+    XFreeEventData(m_display, cookie);
+  }
+}
+
+void TouchWatcher::applyToPresentDevices()
+{
+  if (!m_display || m_mappings.isEmpty())
+    return;
+  int count = 0;
+  XIDeviceInfo *devices = XIQueryDevice(m_display, XIAllDevices, &count);
+  for (int i = 0; i < count; ++i)
+  {
+    if (devices[i].enabled && (devices[i].use == XISlavePointer || devices[i].use == XIFloatingSlave))
+      deviceEnabled(devices[i].deviceid);
+  }
+  XIFreeDeviceInfo(devices);
+}
+
+void TouchWatcher::deviceEnabled(int deviceId)
+{
+  if (m_mappings.isEmpty())
+    return;
+  TraceScope scope("TouchWatcher::deviceEnabled", "input");
+  int count = 0;
+  XIDeviceInfo *info = XIQueryDevice(m_display, deviceId, &count);
+  if (!info)
+    return;
+  const QString name = QString::fromUtf8(info->name).trimmed();
+  const bool isPointer = (info->use == XISlavePointer || info->use == XIFloatingSlave);
+  XIFreeDeviceInfo(info);
+  if (!isPointer)
+    return;
+
+  const QString idPath = udevIdPath(deviceNode(deviceId));
+  auto it = m_mappings.constFind(mappingKey(idPath, name));
+  if (it == m_mappings.constEnd())
+    return;
+  scope.setArg("device", name);
+  scope.setArg("output", it->outputName);
+
+  // Format 32 properties are passed as an array of long, even for FLOAT.
+  long data[9];
+  for (int i = 0; i < 9; ++i)
+  {
+    quint32 bits = 0;
+    memcpy(&bits, &it->matrix[i], sizeof(bits));
+    data[i] = long(bits);
+  }
+  XIChangeProperty(m_display, deviceId, m_matrixAtom, m_floatAtom, 32, PropModeReplace,
+                   reinterpret_cast<unsigned char *>(data), 9);
+  XFlush(m_display);
+  qCInfo(lcTouch) << "Applied touch mapping of" << name << "to" << it->outputName;
+  emit mappingApplied(name, it->outputName);
+}
+
+QString TouchWatcher::deviceNode(int deviceId)
+{
+  Atom type = None;
+  int format = 0;
+  unsigned long items = 0;
+  unsigned long after = 0;
+  unsigned char *data = nullptr;
+  QString node;
+  if (XIGetProperty(m_display, deviceId, m_nodeAtom, 0, 1024, False, XA_STRING,
+                    &type, &format, &items, &after, &data) == Success && data)
+  {
+    if (type == XA_STRING && format == 8)
+      node = QString::fromLocal8Bit(reinterpret_cast<const char *>(data), int(items));
+    XFree(data);
+  }
+  return node;
+}
+
+QString TouchWatcher::udevIdPath(const QString &deviceNode)
+{
+  if (deviceNode.isEmpty())
+    return QString();
+  // /dev/input/eventN -> major:minor -> the udev database entry c<major>:<minor>.
+  QFile devFile("/sys/class/input/" + QFileInfo(deviceNode).fileName() + "/dev");
+  if (!devFile.open(QIODevice::ReadOnly))
+    return QString();
+  const QByteArray majorMinor = devFile.readAll().trimmed();
+  QFile db("/run/udev/data/c" + QString::fromLatin1(majorMinor));
+  if (!db.open(QIODevice::ReadOnly | QIODevice::Text))
+    return QString();
+  while (!db.atEnd())
+  {
+    const QByteArray line = db.readLine().trimmed();
+    if (line.startsWith("E:ID_PATH="))
+      return QString::fromUtf8(line.mid(10));
+  }
+  return QString();
+}
+
+QString TouchWatcher::mappingKey(const QString &idPath, const QString &name)
+{
+  return idPath.trimmed() + '\n' + name.trimmed();
+}
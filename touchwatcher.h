@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QtCore>
+#include "xinputbackend.h"
+
+struct _XDisplay;
+class QSocketNotifier;
+
+// Re-applies the touch mappings as soon as the X server enables an input
+// device, e.g. after a USB reset gave a touch panel a new device id. Listens
+// for XI2 hierarchy events on its own X connection, identifies the device by
+// its name and the ID_PATH from the udev database, and sets the Coordinate
+// Transformation Matrix directly; no xinput or udevadm process is started.
+class TouchWatcher : public QObject
+{
+  Q_OBJECT
+public:
+  explicit TouchWatcher(QObject *parent = nullptr);
+  ~TouchWatcher() override;
+
+  bool start();
+  // Replaces the mapping table and applies it to the devices present now.
+  void setMappings(const QList<XInputDeviceConfig> &configs);
+
+signals:
+  void mappingApplied(const QString &deviceName, const QString &outputName);
+  // An input device was added, removed, enabled or disabled.
+  void devicesChanged();
+
+private:
+  struct Mapping
+  {
+    QString outputName;
+    float matrix[9];
+  };
+
+  _XDisplay *m_display = nullptr;
+  QSocketNotifier *m_notifier = nullptr;
+  int m_xiOpcode = 0;
+  unsigned long m_nodeAtom = 0;
+  unsigned long m_matrixAtom = 0;
+  unsigned long m_floatAtom = 0;
+  // Keyed by id_path and device name, see mappingKey().
+  QHash<QString, Mapping> m_mappings;
+
+  void processEvents();
+  void applyToPresentDevices();
+  void deviceEnabled(int deviceId);
+  QString deviceNode(int deviceId);
+  static QString udevIdPath(const QString &deviceNode);
+  static QString mappingKey(const QString &idPath, const QString &name);
+};
@@ -0,0 +1,116 @@
+#include "tracer.h"
+
+Tracer &Tracer::instance()
+{
+  static Tracer inst;
+  return inst;
+}
+
+void Tracer::enable(const QString &fileName)
+{
+  QMutexLocker locker(&m_mutex);
+  m_fileName = fileName;
+  m_events.clear();
+  m_clock.start();
+  s_enabled = !fileName.isEmpty();
+}
+
+qint64 Tracer::nowUs() const
+{
+  return m_clock.nsecsElapsed() / 1000;
+}
+
+void Tracer::addEvent(TraceEvent event)
+{
+  event.threadId = quint64(quintptr(QThread::currentThreadId()));
+  QMutexLocker locker(&m_mutex);
+  m_events.append(std::move(event));
+}
+
+bool Tracer::writeFile()
+{
+  QMutexLocker locker(&m_mutex);
+  if (!s_enabled)
+    return false;
+
+  const qint64 pid = QCoreApplication::applicationPid();
+  QHash<quint64, int> threadIds;
+  QJsonArray events;
+
+  QJsonObject processName;
+  processName.insert("name", "process_name");
+  processName.insert("ph", "M");
+  processName.insert("pid", pid);
+  processName.insert("tid", 0);
+  processName.insert("args", QJsonObject{{"name", "dpset"}});
+  events.append(processName);
+
+  for (const TraceEvent &event : std::as_const(m_events))
+  {
+    // Chrome's trace viewer expects small thread ids; map the native handles
+    // onto a dense range in order of first appearance.
+    auto it = threadIds.constFind(event.threadId);
+    if (it == threadIds.constEnd())
+      it = threadIds.insert(event.threadId, threadIds.size());
+
+    QJsonObject obj;
+    obj.insert("name", QString::fromUtf8(event.name));
+    obj.insert("cat", QString::fromUtf8(event.category));
+    obj.insert("ph", "X");
+    obj.insert("ts", event.startUs);
+    obj.insert("dur", event.durationUs);
+    obj.insert("pid", pid);
+    obj.insert("tid", it.value());
+    if (!event.args.isEmpty())
+      obj.insert("args", QJsonObject::fromVariantMap(event.args));
+    events.append(obj);
+  }
+
+  QJsonObject root;
+  root.insert("traceEvents", events);
+  root.insert("displayTimeUnit", "ms");
+
+  QFile file(m_fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    qWarning() << "Cannot open trace file for writing:" << m_fileName;
+    return false;
+  }
+  file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+  file.close();
+  return true;
+}
+
+void TraceScope::setProcessResult(const QProcess &proc)
+{
+  if (m_startUs < 0)
+    return;
+  m_args.insert("program", proc.program());
+  m_args.insert("arguments", proc.arguments().join(' '));
+  m_args.insert("exitCode", proc.exitCode());
+  m_args.insert("exitStatus", proc.exitStatus() == QProcess::NormalExit ? "normal" : "crashed");
+  if (proc.error() != QProcess::UnknownError)
+    m_args.insert("error", proc.errorString());
+}
+
+void TraceScope::finish()
+{
+  Tracer &tracer = Tracer::instance();
+  TraceEvent event;
+  event.name = m_name;
+  event.category = m_category;
+  event.startUs = m_startUs;
+  event.durationUs = tracer.nowUs() - m_startUs;
+  event.args = std::move(m_args);
+  tracer.addEvent(std::move(event));
+}
+
+bool runTracedProcess(QProcess &proc, const char *traceName, const QString &program,
+                      const QStringList &arguments, int msecs)
+{
+  TraceScope scope(traceName, "process");
+  proc.start(program, arguments);
+  bool finished = proc.waitForFinished(msecs);
+  scope.setProcessResult(proc);
+  return finished;
+}
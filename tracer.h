@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QtCore>
+
+struct TraceEvent
+{
+  QByteArray name;
+  QByteArray category;
+  qint64 startUs = 0;
+  qint64 durationUs = 0;
+  quint64 threadId = 0;
+  QVariantMap args;
+};
+
+class Tracer
+{
+public:
+  static Tracer& instance();
+  static bool isEnabled() { return s_enabled; }
+
+  void enable(const QString &fileName);
+  qint64 nowUs() const;
+  void addEvent(TraceEvent event);
+  bool writeFile();
+
+private:
+  static inline bool s_enabled = false;
+  QString m_fileName;
+  QElapsedTimer m_clock;
+  QMutex m_mutex;
+  QList<TraceEvent> m_events;
+};
+
+// Records the lifetime of the scope as one complete ("X") event. When tracing
+// is disabled the constructor and destructor reduce to a single flag check.
+class TraceScope
+{
+public:
+  explicit TraceScope(const char *name, const char *category = "dpset")
+  :m_name(name),
+  m_category(category)
+  {
+    if (Tracer::isEnabled())
+      m_startUs = Tracer::instance().nowUs();
+  }
+  ~TraceScope()
+  {
+    if (m_startUs >= 0)
+      finish();
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  bool isActive() const { return m_startUs >= 0; }
+  void setArg(const char *key, const QVariant &value)
+  {
+    if (m_startUs >= 0)
+      m_args.insert(QString::fromLatin1(key), value);
+  }
+  void setProcessResult(const QProcess &proc);
+
+private:
+  const char *m_name;
+  const char *m_category;
+  qint64 m_startUs = -1;
+  QVariantMap m_args;
+
+  void finish();
+};
+
+// Starts the program, waits for it to finish and, when tracing is enabled,
+// records its wall time together with the exit code.
+bool runTracedProcess(QProcess &proc, const char *traceName, const QString &program,
+                      const QStringList &arguments, int msecs = 10000);
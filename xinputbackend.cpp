@@ -1,4 +1,5 @@
 #include "xinputbackend.h"
+#include "tracer.h"
 #include <QtCore>
 #include <QtGui>
 
@@ -10,12 +11,59 @@ XInputBackend &XInputBackend::instance()
 
 QList<XInputDevice> XInputBackend::devices()
 {
+  QMutexLocker locker(&m_mutex);
   if (!m_parsed)
     parseXInput();
 
   return m_devices;
 }
 
+void XInputBackend::loadInBackground()
+{
+  if (m_loader)
+    return;
+  bool parsed;
+  {
+    QMutexLocker locker(&m_mutex);
+    parsed = m_parsed;
+  }
+  if (parsed)
+  {
+    QTimer::singleShot(0, this, &XInputBackend::devicesLoaded);
+    return;
+  }
+  m_loader = QThread::create([this]()
+  {
+    QMutexLocker locker(&m_mutex);
+    parseXInput();
+  });
+  connect(m_loader, &QThread::finished, this, [this]()
+  {
+    m_loader->deleteLater();
+    m_loader = nullptr;
+    emit devicesLoaded();
+    if (m_reloadPending)
+      reloadInBackground();
+  });
+  m_loader->start();
+}
+
+void XInputBackend::reloadInBackground()
+{
+  // A running probe may already have missed the change.
+  if (m_loader)
+  {
+    m_reloadPending = true;
+    return;
+  }
+  m_reloadPending = false;
+  {
+    QMutexLocker locker(&m_mutex);
+    m_parsed = false;
+  }
+  loadInBackground();
+}
+
 QString XInputBackend::buildScript(const QList<XInputDeviceConfig> &configs)
 {
   bool touchDeviceFound = false;
@@ -63,21 +111,45 @@ QString XInputBackend::buildScript(const QList<XInputDeviceConfig> &configs)
   script += "    echo \"-1\"\n";
   script += "    return 1\n";
   script += "}\n\n";
+  // A running X server keeps the matrix, so only set it when it differs.
+  script += "ctm_matches() {\n";
+  script += "    local current\n";
+  script += "    current=$(xinput list-props \"$1\" 2>/dev/null | sed -n 's/.*Coordinate Transformation Matrix ([0-9]*):[[:space:]]*//p' | tr -d ',')\n";
+  script += "    [ -n \"$current\" ] || return 1\n";
+  script += "    awk -v a=\"$current\" -v b=\"$2\" 'BEGIN { n = split(a, x); if (split(b, y) != n) exit 1; "
+            "for (i = 1; i <= n; i++) { d = x[i] - y[i]; if (d < -0.00001 || d > 0.00001) exit 1 } exit 0 }'\n";
+  script += "}\n\n";
+  // Counters for the metrics of the boot script. A device that is not found
+  // yet (e.g. still enumerating at boot) is looked up again DPSET_TOUCH_RETRIES times.
+  script += "touch_max_retries=${DPSET_TOUCH_RETRIES:-0}\n";
+  script += "touch_retries=0\n";
+  script += "touch_not_found=0\n";
+  script += "touch_matrices_set=0\n\n";
 
   for (const XInputDeviceConfig &config : configs)
   {
     if (!config.idPath.isEmpty() && !config.deviceName.isEmpty())
     {
       const QStringList transform = transformToStringList(
-          createScreenTransform(config.totalSize, config.monitorRect, config.orientation)
+          createScreenTransform(config.totalSize, config.monitorRect, config.orientation, config.reflection)
           );
       QString command = "#Touch mapping for " + config.outputName + "\n";
-      command += "DEVICE_ID=$(find_xinput_device \"" + config.idPath + "\" \"" + config.deviceName + "\")\n";
+      const QString find = "find_xinput_device \"" + config.idPath + "\" \"" + config.deviceName + "\"";
+      command += "DEVICE_ID=$(" + find + ")\n";
+      command += "attempt=0\n";
+      command += "while [ \"$DEVICE_ID\" = \"-1\" ] && [ \"$attempt\" -lt \"$touch_max_retries\" ]; do\n";
+      command += "    attempt=$((attempt + 1))\n";
+      command += "    touch_retries=$((touch_retries + 1))\n";
+      command += "    sleep 1\n";
+      command += "    DEVICE_ID=$(" + find + ")\n";
+      command += "done\n";
       command += "if [ \"$DEVICE_ID\" -eq \"-1\" ]; then\n";
+      command += "    touch_not_found=$((touch_not_found + 1))\n";
       command += "    echo \"DEBUG: Could not find touch device for " + config.outputName +
                  " with id_path " + config.idPath + " and name " + config.deviceName + "\" >&2\n";
-      command += "else\n";
+      command += "elif ! ctm_matches \"$DEVICE_ID\" \"" + transform.join(' ') + "\"; then\n";
       command += "    xinput set-prop $DEVICE_ID 'Coordinate Transformation Matrix' " + transform.join(' ') + "\n";
+      command += "    touch_matrices_set=$((touch_matrices_set + 1))\n";
       command += "fi\n\n";
       script += command;
     }
@@ -85,16 +157,65 @@ QString XInputBackend::buildScript(const QList<XInputDeviceConfig> &configs)
   return script;
 }
 
+QString XInputBackend::buildUdevRules(const QList<XInputDeviceConfig> &configs)
+{
+  QString rules;
+  rules += "# Touch calibration generated by dpset.\n";
+  rules += "# Install into /etc/udev/rules.d/ and activate with:\n";
+  rules += "#   udevadm control --reload && udevadm trigger --subsystem-match=input\n";
+  rules += "# libinput reads LIBINPUT_CALIBRATION_MATRIX when the device is added, so the\n";
+  rules += "# mapping also survives a USB reset. The tag selects the evdev configuration.\n";
+  for (const XInputDeviceConfig &config : configs)
+  {
+    if (config.idPath.isEmpty() || config.deviceName.isEmpty())
+      continue;
+    const QTransform T = createScreenTransform(config.totalSize, config.monitorRect, config.orientation, config.reflection);
+    const QStringList calibration = {
+        QString::number(T.m11(), 'g', 8), QString::number(T.m12(), 'g', 8), QString::number(T.m13(), 'g', 8),
+        QString::number(T.m21(), 'g', 8), QString::number(T.m22(), 'g', 8), QString::number(T.m23(), 'g', 8)
+    };
+    rules += "\n# Touch mapping for " + config.outputName + "\n";
+    rules += QString("ACTION==\"add|change\", SUBSYSTEM==\"input\", KERNEL==\"event*\", "
+                     "ENV{ID_PATH}==\"%1\", ATTRS{name}==\"%2\", "
+                     "ENV{LIBINPUT_CALIBRATION_MATRIX}=\"%3\", ENV{ID_INPUT.tags}+=\"%4\"\n")
+                 .arg(udevPattern(config.idPath), udevPattern(config.deviceName),
+                      calibration.join(' '), touchTag(config.outputName));
+  }
+  return rules;
+}
+
+QString XInputBackend::buildEvdevConfig(const QList<XInputDeviceConfig> &configs)
+{
+  QString config;
+  config += "# Touch mapping for the evdev driver generated by dpset.\n";
+  config += "# Requires the matching dpset udev rules; install into /etc/X11/xorg.conf.d/.\n";
+  for (const XInputDeviceConfig &cfg : configs)
+  {
+    if (cfg.idPath.isEmpty() || cfg.deviceName.isEmpty())
+      continue;
+    const QStringList transform = transformToStringList(
+        createScreenTransform(cfg.totalSize, cfg.monitorRect, cfg.orientation, cfg.reflection));
+    config += "\nSection \"InputClass\"\n";
+    config += QString("    Identifier \"dpset touch %1\"\n").arg(cfg.outputName);
+    config += QString("    MatchTag \"%1\"\n").arg(touchTag(cfg.outputName));
+    // libinput already applies LIBINPUT_CALIBRATION_MATRIX from the udev rule.
+    config += "    MatchDriver \"evdev\"\n";
+    config += QString("    Option \"TransformationMatrix\" \"%1\"\n").arg(transform.join(' '));
+    config += "EndSection\n";
+  }
+  return config;
+}
+
 void XInputBackend::parseXInput()
 {
   if (m_parsed)
     return;
   m_parsed = true;
   m_devices.clear();
+  TraceScope parseScope("XInputBackend::parseXInput");
 
   QProcess proc;
-  proc.start("xinput", QStringList() << "list" << "--short");
-  if (!proc.waitForFinished(10000)) {
+  if (!runTracedProcess(proc, "xinput list", "xinput", QStringList() << "list" << "--short")) {
     qWarning() << "xinput timed out or failed.";
     return;
   }
@@ -122,11 +243,14 @@ void XInputBackend::parseXInput()
 
     XInputDevice dev;
     dev.name = devName;
+    dev.id = devId;
 
     //get device id_path
+    TraceScope devScope("resolve touch device");
+    devScope.setArg("device", devName);
     QProcess propProc;
-    propProc.start("xinput", QStringList() << "--list-props" << QString::number(devId));
-    if (propProc.waitForFinished(10000))
+    if (runTracedProcess(propProc, "xinput --list-props", "xinput",
+                         QStringList() << "--list-props" << QString::number(devId)))
     {
       QString propOutput = QString::fromLocal8Bit(propProc.readAllStandardOutput());
       QRegularExpression rxNode(R"(Device Node\s*\(.*\):\s*\"(.*)\"\s*)");
@@ -135,8 +259,7 @@ void XInputBackend::parseXInput()
       {
         QString devNode = matchNode.captured(1).trimmed();
         QProcess udevProc;
-        udevProc.start("udevadm", QStringList() << "info" << devNode);
-        if(udevProc.waitForFinished(10000))
+        if(runTracedProcess(udevProc, "udevadm info", "udevadm", QStringList() << "info" << devNode))
         {
           QString udevOutput = QString::fromLocal8Bit(udevProc.readAllStandardOutput());
           QRegularExpression rxPath(R"(ID_PATH=(.*))");
@@ -156,7 +279,13 @@ void XInputBackend::parseXInput()
   }
 }
 
-QTransform XInputBackend::createScreenTransform(const QSize &totalSize, const QRect &screenRect, Orientation orientation)
+QTransform XInputBackend::screenTransform(const XInputDeviceConfig &config)
+{
+  return createScreenTransform(config.totalSize, config.monitorRect, config.orientation, config.reflection);
+}
+
+QTransform XInputBackend::createScreenTransform(const QSize &totalSize, const QRect &screenRect,
+                                               Orientation orientation, Reflection reflection)
 {
   int boundingW = screenRect.width();
   int boundingH = screenRect.height();
@@ -191,12 +320,38 @@ QTransform XInputBackend::createScreenTransform(const QSize &totalSize, const QR
       break;
   }
 
+  // RandR reflects the rotated picture, so the reflection follows the rotation.
+  const bool reflectX = reflection == Reflection::X || reflection == Reflection::XY;
+  const bool reflectY = reflection == Reflection::Y || reflection == Reflection::XY;
+  QTransform F;
+  F.setMatrix(reflectX ? -1 : 1, 0, reflectX ? 1 : 0, 0, reflectY ? -1 : 1, reflectY ? 1 : 0, 0, 0, 1);
+
   QTransform M = S;
+  M *= F;
   M *= R;
 
   return M;
 }
 
+QString XInputBackend::touchTag(const QString &outputName)
+{
+  QString tag = "dpset_" + outputName;
+  for (QChar &c : tag)
+  {
+    if (!c.isLetterOrNumber() && c != '_')
+      c = '_';
+  }
+  return tag;
+}
+
+QString XInputBackend::udevPattern(const QString &value)
+{
+  // udev has no escape for quotes inside a match; '?' matches any character.
+  QString pattern = value;
+  pattern.replace('"', '?');
+  return pattern;
+}
+
 QStringList XInputBackend::transformToStringList(const QTransform &T)
 {
   QStringList list;
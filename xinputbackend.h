@@ -6,6 +6,8 @@ struct XInputDevice
 {
   QString name;
   QString idPath;
+  // X input device id; only valid for the running server.
+  int id = -1;
 };
 
 struct XInputDeviceConfig
@@ -14,6 +16,7 @@ struct XInputDeviceConfig
   QString deviceName; // nieuw veld
   QString outputName;
   Orientation orientation;
+  Reflection reflection = Reflection::None;
   QSize totalSize;
   QRect monitorRect;
 };
@@ -24,13 +27,31 @@ class XInputBackend : public QObject
 public:
   static XInputBackend& instance();
   QList<XInputDevice> devices();
+  // Probes the devices on a worker thread and emits devicesLoaded() on the
+  // thread of the backend. devices() blocks until a running probe has finished.
+  void loadInBackground();
+  // Forgets the devices and probes them again, e.g. after a device was
+  // plugged in; devicesLoaded() is emitted once the new list is ready.
+  void reloadInBackground();
   QString buildScript(const QList<XInputDeviceConfig>& configs);
+  QString buildUdevRules(const QList<XInputDeviceConfig>& configs);
+  QString buildEvdevConfig(const QList<XInputDeviceConfig>& configs);
+  QTransform screenTransform(const XInputDeviceConfig& config);
+signals:
+  void devicesLoaded();
+
 private:
+  QMutex m_mutex;
   QList<XInputDevice> m_devices;
   bool m_parsed = false;
+  QThread *m_loader = nullptr;
+  bool m_reloadPending = false;
   void parseXInput();
   QTransform createScreenTransform(const QSize& totalSize,
                                    const QRect& screenRect,
-                                   Orientation orientation);
+                                   Orientation orientation,
+                                   Reflection reflection);
   QStringList transformToStringList(const QTransform& T);
+  static QString touchTag(const QString &outputName);
+  static QString udevPattern(const QString &value);
 };
@@ -1,4 +1,89 @@
 #include "xrandrbackend.h"
+#include "modeline.h"
+#include "tracer.h"
+
+namespace
+{
+  QString shellQuote(const QString &argument)
+  {
+    static const QRegularExpression unsafe(R"([^A-Za-z0-9_.,:+=/@%-])");
+    if (!argument.isEmpty() && !argument.contains(unsafe))
+      return argument;
+    QString quoted = argument;
+    quoted.replace('\'', "'\\''");
+    return "'" + quoted + "'";
+  }
+
+  bool sameMatrix(const QTransform &a, const QTransform &b)
+  {
+    const qreal va[] = {a.m11(), a.m12(), a.m13(), a.m21(), a.m22(), a.m23(), a.m31(), a.m32(), a.m33()};
+    const qreal vb[] = {b.m11(), b.m12(), b.m13(), b.m21(), b.m22(), b.m23(), b.m31(), b.m32(), b.m33()};
+    for (int i = 0; i < 9; ++i)
+    {
+      // xrandr prints the 16.16 fixed point values with six decimals.
+      if (qAbs(va[i] - vb[i]) > 0.001)
+        return false;
+    }
+    return true;
+  }
+
+  // Refresh rate of the mode when it is the one in use, else the usual 60 Hz.
+  double refreshRate(const XRandrMonitorInfo &info, const QSize &mode)
+  {
+    const Modeline &current = info.currentMode;
+    if (current.hDisplay == mode.width() && current.vDisplay == mode.height() && current.refreshRate() > 0)
+      return current.refreshRate();
+    return 60.0;
+  }
+
+  quint32 currentModeId(const XRandrMonitorInfo &info)
+  {
+    for (const XRandrMode &mode : info.modes)
+    {
+      if (mode.current)
+        return mode.id;
+    }
+    return 0;
+  }
+
+  // The server assigns mode XIDs at runtime, so a script names the shared
+  // mode by name and refresh rate instead; both outputs list the same mode
+  // object, which xrandr then picks on each of them.
+  XRandrMonitorConfig withModeByName(XRandrMonitorConfig config, const QHash<QString, XRandrMonitorInfo> &monitors)
+  {
+    if (config.modeId == 0)
+      return config;
+    for (const XRandrMode &mode : monitors.value(config.screenName).modes)
+    {
+      if (mode.id == config.modeId)
+        config.rate = mode.modeline.refreshRate();
+    }
+    config.modeId = 0;
+    return config;
+  }
+
+  // XIDs of the modes of the size, the one in use and the preferred one first.
+  QList<quint32> sharedModeCandidates(const XRandrMonitorInfo &info, const QSize &size)
+  {
+    QList<quint32> ids;
+    for (bool pass : {true, false})
+    {
+      for (const XRandrMode &mode : info.modes)
+      {
+        if (mode.size() == size && (mode.current || mode.preferred) == pass && !ids.contains(mode.id))
+          ids << mode.id;
+      }
+    }
+    return ids;
+  }
+
+  QSize screenSize(const XRandrMonitorConfig &config)
+  {
+    if (config.orientation == "left" || config.orientation == "right")
+      return config.resolution.transposed();
+    return config.resolution;
+  }
+}
 
 XRandrBackend &XRandrBackend::instance()
 {
@@ -6,6 +91,12 @@ XRandrBackend &XRandrBackend::instance()
   return inst;
 }
 
+const QStringList &XRandrBackend::tunableProperties()
+{
+  static const QStringList properties = {"TearFree", "max bpc", "Broadcast RGB", "Colorspace"};
+  return properties;
+}
+
 const QHash<QString, XRandrMonitorInfo> &XRandrBackend::monitors()
 {
   if (!m_parsed)
@@ -13,6 +104,13 @@ const QHash<QString, XRandrMonitorInfo> &XRandrBackend::monitors()
   return m_monitorMap;
 }
 
+const XRandrScreenInfo &XRandrBackend::screen()
+{
+  if (!m_parsed)
+    parseXRandr();
+  return m_screen;
+}
+
 QStringList XRandrBackend::connectedMonitorNames()
 {
   if (!m_parsed)
@@ -24,94 +122,853 @@ QStringList XRandrBackend::connectedMonitorNames()
   return result;
 }
 
+QList<QStringList> XRandrBackend::modeCommands(const QList<XRandrMonitorConfig> &configs) const
+{
+  QList<QStringList> commands;
+  QSet<QString> createdModes;
+  for (const XRandrMonitorConfig &config : configs)
+  {
+    if (config.screenName.isEmpty() || !config.isCustom)
+      continue;
+    const Modeline mode = cvtModeline(config.resolution.width(), config.resolution.height());
+    if (!createdModes.contains(mode.name))
+    {
+      createdModes.insert(mode.name);
+      commands << (QStringList() << "--newmode" << mode.name << mode.timingArguments());
+    }
+    commands << (QStringList() << "--addmode" << config.screenName << mode.name);
+  }
+  return commands;
+}
+
+QStringList XRandrBackend::outputArguments(const QList<XRandrMonitorConfig> &configs) const
+{
+  QStringList arguments;
+  for (const XRandrMonitorConfig &config : configs)
+  {
+    if (config.screenName.isEmpty())
+      continue;
+    arguments << "--output" << config.screenName;
+    if (config.crtc >= 0)
+      arguments << "--crtc" << QString::number(config.crtc);
+    if (config.modeId != 0)
+      arguments << "--mode" << QString("0x%1").arg(config.modeId, 0, 16);
+    else
+      arguments << "--mode" << modeName(config);
+    if (config.modeId == 0 && config.rate > 0)
+      arguments << "--rate" << QString::number(config.rate, 'f', 2);
+    // A clone on a CRTC of its own is placed relative to its source.
+    if (!config.cloneOf.isEmpty() && config.crtc < 0)
+      arguments << "--same-as" << config.cloneOf;
+    else
+      arguments << "--pos" << QString("%1x%2")
+                                  .arg(config.position.x())
+                                  .arg(config.position.y());
+    if (config.scaleFrom.isValid())
+      arguments << "--rotate" << config.orientation << "--reflect" << config.reflection
+                << "--scale-from" << QString("%1x%2").arg(config.scaleFrom.width()).arg(config.scaleFrom.height());
+    else if (config.emulatedRotation)
+      arguments << "--rotate" << "normal" << "--reflect" << "normal"
+                << "--transform" << transformArgument(config);
+    else
+      arguments << "--rotate" << config.orientation << "--reflect" << config.reflection
+                << "--transform" << "none";
+    if (config.isPrimary)
+      arguments << "--primary";
+    for (auto it = config.properties.constBegin(); it != config.properties.constEnd(); ++it)
+      arguments << "--set" << it.key() << it.value();
+  }
+  arguments << monitorArguments(configs);
+  return arguments;
+}
+
+QStringList XRandrBackend::monitorArguments(const QList<XRandrMonitorConfig> &configs)
+{
+  QStringList arguments;
+  QStringList monitors;
+  for (const XRandrMonitorConfig &config : configs)
+  {
+    if (!config.monitor.isEmpty() && !monitors.contains(config.monitor))
+      monitors << config.monitor;
+  }
+  for (const QString &monitor : std::as_const(monitors))
+  {
+    QStringList tiles;
+    for (const XRandrMonitorConfig &config : configs)
+    {
+      if (config.monitor == monitor)
+        tiles << config.screenName;
+    }
+    // One tile alone would make a monitor of half the display.
+    if (tiles.size() > 1)
+      arguments << "--setmonitor" << monitor << "auto" << tiles.join(',');
+  }
+  return arguments;
+}
+
 QString XRandrBackend::buildScript(const QList<XRandrMonitorConfig> &configs) const
 {
   if (configs.isEmpty())
     return QString();
 
+  // $randr_verbose holds "xrandr --current --verbose", which does not probe
+  // the outputs, so the script can return without any modeset when the
+  // layout is already active, e.g. after a display manager restart.
   QString script;
-  QStringList standardArguments;
-  standardArguments << "xrandr";
+  script += "# Current RandR state, one line per output and per output property.\n";
+  script += "current_state=\"$(printf '%s\\n' \"$randr_verbose\" | awk '\n";
+  script += "    /^[^ \\t]/ && ($2 == \"connected\" || $2 == \"disconnected\") {\n";
+  script += "        output = $1; primary = \"\"; geometry = \"\"; rotation = \"normal\"\n";
+  script += "        for (i = 3; i <= NF; i++) {\n";
+  script += "            if ($i == \"primary\") { primary = \" primary\"; continue }\n";
+  script += "            if ($i ~ /^[0-9]+x[0-9]+[+-][0-9]+[+-][0-9]+$/) {\n";
+  script += "                geometry = \" \" $i\n";
+  script += "                if ($(i + 1) ~ /^\\(0x/) i++\n";
+  script += "                if ($(i + 1) ~ /^(normal|left|inverted|right)$/) { rotation = $(i + 1); i++ }\n";
+  script += "                if ($(i + 1) == \"X\" && $(i + 2) == \"and\") rotation = rotation \" X and Y axis\"\n";
+  script += "                else if ($(i + 1) ~ /^[XY]$/ && $(i + 2) == \"axis\") rotation = rotation \" \" $(i + 1) \" axis\"\n";
+  script += "                break\n";
+  script += "            }\n";
+  script += "        }\n";
+  script += "        print output \"|\" $2 primary geometry \" \" rotation\n";
+  script += "        next\n";
+  script += "    }\n";
+  script += "    /^\\t[^\\t]/ && output != \"\" {\n";
+  script += "        line = substr($0, 2); i = index(line, \":\")\n";
+  script += "        if (i == 0) next\n";
+  script += "        value = substr(line, i + 1); sub(/^[ \\t]+/, \"\", value); sub(/[ \\t]+$/, \"\", value)\n";
+  script += "        print output \"|\" substr(line, 1, i - 1) \"=\" value\n";
+  script += "    }')\"\n";
+  script += "state_matches() {\n";
+  script += "    grep -qxF -- \"$1\" <<< \"$current_state\"\n";
+  script += "}\n\n";
+  script += "xrandr_args=()\n";
 
+  QSet<QString> writtenMonitors;
   for (const XRandrMonitorConfig &config : configs)
   {
-    if (config.screenName.isEmpty())
+    if (config.screenName.isEmpty() || writtenMonitors.contains(config.monitor))
       continue;
+    // The tiles of a monitor are set together, so the panel never runs
+    // with mismatched halves.
+    QList<XRandrMonitorConfig> unit{config};
+    if (!config.monitor.isEmpty())
+    {
+      writtenMonitors.insert(config.monitor);
+      unit.clear();
+      for (const XRandrMonitorConfig &tile : configs)
+      {
+        if (tile.monitor == config.monitor)
+          unit << tile;
+      }
+    }
+    QStringList checks;
+    QStringList names;
+    for (const XRandrMonitorConfig &member : std::as_const(unit))
+    {
+      names << member.screenName;
+      for (const QString &line : fingerprint(member))
+        checks << "! state_matches " + shellQuote(line);
+    }
+    QList<XRandrMonitorConfig> scriptUnit;
+    for (const XRandrMonitorConfig &member : std::as_const(unit))
+      scriptUnit << withModeByName(member, m_monitorMap);
+    QStringList arguments;
+    for (const QString &argument : outputArguments(scriptUnit))
+      arguments << shellQuote(argument);
 
-    bool isCustom = true;
-    if (m_monitorMap.contains(config.screenName))
+    if (config.monitor.isEmpty())
+      script += QString("\n# %1\n").arg(config.screenName);
+    else
+      script += QString("\n# %1: tiled display on %2\n").arg(config.monitor, names.join(", "));
+    if (!config.cloneOf.isEmpty())
+      script += "# " + cloneComment(config) + "\n";
+    script += "if " + checks.join(" || ") + "; then\n";
+    if (config.isCustom)
     {
-      const XRandrMonitorInfo &info = m_monitorMap.value(config.screenName);
-      if (info.allResolutions.contains(config.resolution))
-        isCustom = false;
+      const Modeline mode = cvtModeline(config.resolution.width(), config.resolution.height());
+      script += "    # Custom resolution\n";
+      script += QString("    if ! xrandr --current | grep -w \"%1\" > /dev/null; then\n").arg(mode.name);
+      script += QString("        xrandr --newmode \"%1\" %2\n").arg(mode.name, mode.timingArguments().join(' '));
+      script += "    fi\n";
+      script += QString("    xrandr --addmode %1 %2\n").arg(config.screenName, mode.name);
     }
+    script += "    xrandr_args+=(" + arguments.join(" ") + ")\n";
+    script += "fi\n";
+  }
+
+  script += "\nif [ ${#xrandr_args[@]} -eq 0 ]; then\n";
+  script += "    echo \"Monitor layout already active.\"\n";
+  script += "else\n";
+  script += "    xrandr \"${xrandr_args[@]}\"\n";
+  script += "fi";
+  return script;
+}
 
-    if (isCustom)
+QStringList XRandrBackend::fingerprint(const XRandrMonitorConfig &config)
+{
+  // A scaled clone covers the area of its source.
+  const QSize size = config.scaleFrom.isValid() ? config.scaleFrom : screenSize(config);
+  // xrandr reports an emulated rotation as an unrotated output with a transform.
+  QString rotation = config.emulatedRotation ? "normal" : config.orientation;
+  if (!config.emulatedRotation)
+  {
+    switch (stringToReflection(config.reflection))
     {
-      script += QString("# Custom resolution for %1\n").arg(config.screenName);
-      script += QString("MODELINE=$(cvt %1 %2 | sed -n '2p' | sed 's/^Modeline //')\n")
-                    .arg(config.resolution.width())
-                    .arg(config.resolution.height());
-      script += "MODE_NAME=$(echo $MODELINE | cut -d ' ' -f 1 | tr -d '\"')\n";
-      script += "MODE_PARAMS=$(echo $MODELINE | cut -d ' ' -f 2-)\n";
-      script += "if ! xrandr --query | grep -w \"$MODE_NAME\" > /dev/null; then\n";
-      script += "    xrandr --newmode $MODE_NAME $MODE_PARAMS\n";
-      script += "fi\n";
-      script += QString("xrandr --addmode %1 $MODE_NAME\n").arg(config.screenName);
-      script += QString("xrandr --output %1 --mode $MODE_NAME --pos %2x%3 --rotate %4")
-                    .arg(config.screenName)
-                    .arg(config.position.x())
-                    .arg(config.position.y())
-                    .arg(config.orientation);
-      if (config.isPrimary)
-        script += " --primary";
-      script += "\n\n";
+      case Reflection::None: break;
+      case Reflection::X: rotation += " X axis"; break;
+      case Reflection::Y: rotation += " Y axis"; break;
+      case Reflection::XY: rotation += " X and Y axis"; break;
     }
-    else
+  }
+  QStringList lines;
+  lines << QString("%1|connected%2 %3x%4+%5+%6 %7")
+               .arg(config.screenName, config.isPrimary ? " primary" : "")
+               .arg(size.width()).arg(size.height())
+               .arg(config.position.x()).arg(config.position.y())
+               .arg(rotation);
+  if (config.emulatedRotation)
+  {
+    // Only the first row; the continuation lines carry no property name.
+    const QTransform t = rotationTransform(config.resolution, stringToOrientation(config.orientation),
+                                           stringToReflection(config.reflection));
+    lines << QString::asprintf("%s|Transform=%f %f %f", qPrintable(config.screenName),
+                               t.m11() + 0.0, t.m12() + 0.0, t.m13() + 0.0);
+  }
+  for (auto it = config.properties.constBegin(); it != config.properties.constEnd(); ++it)
+    lines << QString("%1|%2=%3").arg(config.screenName, it.key(), it.value());
+  return lines;
+}
+
+QList<XRandrMonitorConfig> XRandrBackend::changedConfigs(const QList<XRandrMonitorConfig> &configs) const
+{
+  auto matches = [this](const XRandrMonitorConfig &config)
+  {
+    auto it = m_monitorMap.constFind(config.screenName);
+    bool same = it != m_monitorMap.constEnd() && it->connected
+                && it->currentResolution == config.resolution
+                && it->position == config.position
+                && orientationToString(it->orientation) == config.orientation
+                && reflectionToString(it->reflection) == config.reflection
+                && it->emulatedRotation == config.emulatedRotation
+                && it->isPrimary == config.isPrimary
+                && (config.crtc < 0 || it->crtc == config.crtc)
+                && (config.modeId == 0 || currentModeId(*it) == config.modeId)
+                && (config.rate <= 0 || qAbs(it->currentMode.refreshRate() - config.rate) < 0.05);
+    for (auto prop = config.properties.constBegin(); same && prop != config.properties.constEnd(); ++prop)
+      same = it->properties.value(prop.key()).value == prop.value();
+    return same;
+  };
+
+  QList<XRandrMonitorConfig> changed;
+  QSet<QString> changedMonitors;
+  for (const XRandrMonitorConfig &config : configs)
+  {
+    if (config.screenName.isEmpty() || matches(config))
+      continue;
+    changed << config;
+    if (!config.monitor.isEmpty())
+      changedMonitors.insert(config.monitor);
+  }
+  if (changedMonitors.isEmpty())
+    return changed;
+
+  changed.clear();
+  for (const XRandrMonitorConfig &config : configs)
+  {
+    if (!config.screenName.isEmpty() && (changedMonitors.contains(config.monitor) || !matches(config)))
+      changed << config;
+  }
+  return changed;
+}
+
+QString XRandrBackend::buildXorgConfig(const QList<XRandrMonitorConfig> &configs) const
+{
+  QString config;
+  config += "# Monitor layout generated by dpset.\n";
+  config += "# Install into /etc/X11/xorg.conf.d/ so the X server starts with this layout.\n";
+  for (const XRandrMonitorConfig &cfg : configs)
+  {
+    if (cfg.screenName.isEmpty())
+      continue;
+    // Without a Monitor-<output> option in the Device section the server
+    // uses the Monitor section whose identifier equals the output name.
+    config += "\n";
+    if (!cfg.cloneOf.isEmpty())
+      config += "# " + cloneComment(cfg) + "\n";
+    config += "Section \"Monitor\"\n";
+    config += QString("    Identifier \"%1\"\n").arg(cfg.screenName);
+    if (cfg.isCustom)
     {
-      standardArguments << "--output" << config.screenName
-                        << "--mode" << QString("%1x%2")
-                                           .arg(config.resolution.width())
-                                           .arg(config.resolution.height())
-                        << "--pos" << QString("%1x%2")
-                                          .arg(config.position.x())
-                                          .arg(config.position.y())
-                        << "--rotate" << config.orientation;
-      if (config.isPrimary)
-        standardArguments << "--primary";
+      const Modeline mode = cvtModeline(cfg.resolution.width(), cfg.resolution.height());
+      config += QString("    Modeline \"%1\" %2\n").arg(mode.name, mode.timingArguments().join(' '));
     }
+    config += QString("    Option \"PreferredMode\" \"%1\"\n").arg(modeName(cfg));
+    config += QString("    Option \"Position\" \"%1 %2\"\n").arg(cfg.position.x()).arg(cfg.position.y());
+    config += QString("    Option \"Rotate\" \"%1\"\n").arg(cfg.orientation);
+    if (cfg.isPrimary)
+      config += "    Option \"Primary\" \"true\"\n";
+    config += "EndSection\n";
   }
-  if (standardArguments.size() > 1)
-    script += standardArguments.join(" ");
+  return config;
+}
+
+QStringList XRandrBackend::validateXorgConfig(const QString &config, const QList<XRandrMonitorConfig> &configs) const
+{
+  struct ParsedMonitor
+  {
+    QHash<QString, QSize> modelines;
+    QHash<QString, QString> options;
+  };
+  QHash<QString, ParsedMonitor> monitors;
+  QRegularExpression reToken(R"re("([^"]*)"|(\S+))re");
+  QString currentIdentifier;
+  ParsedMonitor current;
+  bool inMonitor = false;
+
+  const QStringList lines = config.split('\n');
+  for (const QString &rawLine : lines)
+  {
+    QString line = rawLine.section('#', 0, 0).trimmed();
+    if (line.isEmpty())
+      continue;
+    QStringList tokens;
+    QRegularExpressionMatchIterator it = reToken.globalMatch(line);
+    while (it.hasNext())
+    {
+      QRegularExpressionMatch m = it.next();
+      tokens << (m.capturedStart(1) >= 0 ? m.captured(1) : m.captured(2));
+    }
+    const QString keyword = tokens.constFirst().toLower();
+    if (keyword == "section" && tokens.size() > 1)
+    {
+      inMonitor = tokens.at(1).compare("Monitor", Qt::CaseInsensitive) == 0;
+      currentIdentifier.clear();
+      current = ParsedMonitor();
+    }
+    else if (keyword == "endsection")
+    {
+      if (inMonitor && !currentIdentifier.isEmpty())
+        monitors.insert(currentIdentifier, current);
+      inMonitor = false;
+    }
+    else if (inMonitor && keyword == "identifier" && tokens.size() > 1)
+    {
+      currentIdentifier = tokens.at(1);
+    }
+    else if (inMonitor && keyword == "modeline" && tokens.size() > 10)
+    {
+      current.modelines.insert(tokens.at(1), QSize(tokens.at(3).toInt(), tokens.at(7).toInt()));
+    }
+    else if (inMonitor && keyword == "option" && tokens.size() > 2)
+    {
+      current.options.insert(tokens.at(1).toLower(), tokens.at(2));
+    }
+  }
+
+  QStringList problems;
+  QRegularExpression reModeSize(R"(^(\d+)x(\d+))");
+  for (const XRandrMonitorConfig &cfg : configs)
+  {
+    if (cfg.screenName.isEmpty())
+      continue;
+    auto it = monitors.constFind(cfg.screenName);
+    if (it == monitors.constEnd())
+    {
+      problems << QCoreApplication::translate("XRandrBackend", "%1: no Monitor section found.").arg(cfg.screenName);
+      continue;
+    }
+
+    const QString preferred = it->options.value("preferredmode");
+    QSize size = it->modelines.value(preferred);
+    if (!size.isValid())
+    {
+      QRegularExpressionMatch m = reModeSize.match(preferred);
+      if (m.hasMatch())
+        size = QSize(m.captured(1).toInt(), m.captured(2).toInt());
+    }
+    if (size != cfg.resolution)
+    {
+      problems << QCoreApplication::translate("XRandrBackend", "%1: mode %2 does not give %3x%4.")
+                      .arg(cfg.screenName, preferred)
+                      .arg(cfg.resolution.width())
+                      .arg(cfg.resolution.height());
+    }
+
+    const QStringList position = it->options.value("position").split(' ', Qt::SkipEmptyParts);
+    QPoint pos(-1, -1);
+    if (position.size() == 2)
+      pos = QPoint(position.at(0).toInt(), position.at(1).toInt());
+    if (pos != cfg.position)
+    {
+      problems << QCoreApplication::translate("XRandrBackend", "%1: position %2,%3 is not %4,%5.")
+                      .arg(cfg.screenName)
+                      .arg(pos.x()).arg(pos.y())
+                      .arg(cfg.position.x()).arg(cfg.position.y());
+    }
+    if (cfg.position.x() < 0 || cfg.position.y() < 0)
+    {
+      problems << QCoreApplication::translate("XRandrBackend", "%1: the X server does not accept negative positions.")
+                      .arg(cfg.screenName);
+    }
+
+    const QString rotate = it->options.value("rotate", "normal");
+    if (stringToOrientation(rotate) != stringToOrientation(cfg.orientation))
+    {
+      problems << QCoreApplication::translate("XRandrBackend", "%1: rotation %2 is not %3.")
+                      .arg(cfg.screenName, rotate, cfg.orientation);
+    }
+
+    if (cfg.reflection != "normal")
+    {
+      problems << QCoreApplication::translate("XRandrBackend", "%1: reflection cannot be set in the Xorg configuration.")
+                      .arg(cfg.screenName);
+    }
+
+    const bool primary = it->options.value("primary").compare("true", Qt::CaseInsensitive) == 0;
+    if (primary != cfg.isPrimary)
+    {
+      problems << QCoreApplication::translate("XRandrBackend", "%1: primary flag does not match.").arg(cfg.screenName);
+    }
+  }
+  return problems;
+}
+
+bool XRandrBackend::matchesCurrentState(const QList<XRandrMonitorConfig> &configs) const
+{
+  return changedConfigs(configs).isEmpty();
+}
+
+void XRandrBackend::planClones(QList<XRandrMonitorConfig> &configs, const QHash<QString, XRandrMonitorInfo> &monitors)
+{
+  QHash<QString, int> indexByName;
+  for (int i = 0; i < configs.size(); ++i)
+    indexByName.insert(configs.at(i).screenName, i);
+
+  for (int source = 0; source < configs.size(); ++source)
+  {
+    QList<int> clones;
+    for (int i = 0; i < configs.size(); ++i)
+    {
+      if (configs.at(i).cloneOf == configs.at(source).screenName)
+        clones << i;
+    }
+    if (clones.isEmpty())
+      continue;
+
+    const XRandrMonitorConfig src = configs.at(source);
+    // Outputs on one CRTC need the same mode object and transform and have
+    // to list each other as possible clones. Modes of the same size can
+    // still differ in timing, so only an XID in every mode list will do.
+    // A custom mode is one object by name, see modeCommands().
+    QList<quint32> modeIds = sharedModeCandidates(monitors.value(src.screenName), src.resolution);
+    QList<int> group{source};
+    QList<int> crtcs = monitors.value(src.screenName).crtcs;
+    for (int clone : std::as_const(clones))
+    {
+      XRandrMonitorConfig &cfg = configs[clone];
+      cfg.position = src.position;
+      cfg.crtc = -1;
+      cfg.modeId = 0;
+      cfg.scaleFrom = QSize();
+      if (cfg.resolution != src.resolution || cfg.isCustom != src.isCustom)
+      {
+        cfg.scaleFrom = screenSize(src);
+        continue;
+      }
+      const XRandrMonitorInfo info = monitors.value(cfg.screenName);
+      QList<quint32> commonIds;
+      if (!src.isCustom)
+      {
+        const QList<quint32> ids = sharedModeCandidates(info, cfg.resolution);
+        for (quint32 id : std::as_const(modeIds))
+        {
+          if (ids.contains(id))
+            commonIds << id;
+        }
+      }
+      bool clonable = src.isCustom || !commonIds.isEmpty();
+      for (int member : std::as_const(group))
+      {
+        const QString &name = configs.at(member).screenName;
+        clonable = clonable && info.clones.contains(name)
+                   && monitors.value(name).clones.contains(cfg.screenName);
+      }
+      QList<int> shared;
+      for (int crtc : std::as_const(crtcs))
+      {
+        if (info.crtcs.contains(crtc))
+          shared << crtc;
+      }
+      if (clonable && !shared.isEmpty())
+      {
+        group << clone;
+        crtcs = shared;
+        if (!src.isCustom)
+          modeIds = commonIds;
+      }
+    }
+    if (group.size() < 2)
+      continue;
+
+    // Keep the CRTC of the source if the whole group can use it, otherwise
+    // take one no output outside the group holds.
+    QSet<int> taken;
+    for (auto it = monitors.constBegin(); it != monitors.constEnd(); ++it)
+    {
+      const int index = indexByName.value(it.key(), -1);
+      if (it->crtc >= 0 && !group.contains(index))
+        taken.insert(it->crtc);
+    }
+    int crtc = monitors.value(src.screenName).crtc;
+    if (!crtcs.contains(crtc) || taken.contains(crtc))
+    {
+      crtc = -1;
+      for (int candidate : std::as_const(crtcs))
+      {
+        if (!taken.contains(candidate))
+        {
+          crtc = candidate;
+          break;
+        }
+      }
+    }
+    if (crtc < 0)
+      continue;
+    for (int member : std::as_const(group))
+    {
+      configs[member].crtc = crtc;
+      if (!src.isCustom)
+        configs[member].modeId = modeIds.constFirst();
+    }
+  }
+}
+
+double XRandrBackend::scanoutBytesPerSecond(const QSize &area, double refreshRate)
+{
+  return double(area.width()) * area.height() * 4.0 * refreshRate;
+}
+
+QString XRandrBackend::cloneComment(const XRandrMonitorConfig &config) const
+{
+  const XRandrMonitorInfo info = m_monitorMap.value(config.screenName);
+  const QSize area = config.scaleFrom.isValid() ? config.scaleFrom : screenSize(config);
+  const double rate = config.rate > 0 ? config.rate : refreshRate(info, config.resolution);
+  const double megabytes = scanoutBytesPerSecond(area, rate) / 1e6;
+  if (config.crtc >= 0)
+  {
+    return QString("%1 mirrors %2 on shared CRTC %3: one scanout instead of two saves %4 MB/s of memory bandwidth.")
+        .arg(config.screenName, config.cloneOf).arg(config.crtc).arg(megabytes, 0, 'f', 0);
+  }
+  if (config.scaleFrom.isValid())
+  {
+    return QString("%1 mirrors %2 with --scale-from %3x%4 because its mode differs; its own scanout reads %5 MB/s.")
+        .arg(config.screenName, config.cloneOf)
+        .arg(config.scaleFrom.width()).arg(config.scaleFrom.height())
+        .arg(megabytes, 0, 'f', 0);
+  }
+  return QString("%1 mirrors %2 with --same-as because they cannot share a CRTC; its own scanout reads %3 MB/s.")
+      .arg(config.screenName, config.cloneOf).arg(megabytes, 0, 'f', 0);
+}
+
+QString XRandrBackend::edidFingerprint(const QByteArray &edid)
+{
+  if (edid.isEmpty())
+    return QString();
+  return QString::fromLatin1(QCryptographicHash::hash(edid.toHex(), QCryptographicHash::Sha256).toHex());
+}
+
+QString XRandrBackend::buildEdidCheck(const QMap<QString, QString> &fingerprints)
+{
+  if (fingerprints.isEmpty())
+    return QString();
+  QString script;
+  script += "# The EDID of each output, as xrandr prints it, hashed with SHA-256.\n";
+  script += "edid_fingerprint() {\n";
+  script += "    printf '%s\\n' \"$randr_verbose\" | awk -v output=\"$1\" '\n";
+  script += "        /^[^ \\t]/ { inside = ($1 == output); edid = 0; next }\n";
+  script += "        inside && /^\\tEDID:/ { edid = 1; next }\n";
+  script += "        inside && edid && /^\\t\\t[0-9a-f]+$/ { gsub(/[ \\t]/, \"\"); printf \"%s\", $0; next }\n";
+  script += "        { edid = 0 }' | sha256sum | cut -d' ' -f1\n";
+  script += "}\n";
+  script += "if [ \"${DPSET_SKIP_EDID_CHECK:-0}\" != \"1\" ]; then\n";
+  for (auto it = fingerprints.constBegin(); it != fingerprints.constEnd(); ++it)
+  {
+    script += QString("    if [ \"$(edid_fingerprint %1)\" != \"%2\" ]; then\n").arg(shellQuote(it.key()), it.value());
+    script += QString("        echo \"The monitor on %1 is not the one this layout was made for.\" >&2\n").arg(it.key());
+    script += "        exit 3\n";
+    script += "    fi\n";
+  }
+  script += "fi\n\n";
   return script;
 }
 
+QString XRandrBackend::modeName(const XRandrMonitorConfig &config)
+{
+  if (config.isCustom)
+    return cvtModeline(config.resolution.width(), config.resolution.height()).name;
+  return QString("%1x%2").arg(config.resolution.width()).arg(config.resolution.height());
+}
+
+QTransform XRandrBackend::rotationTransform(const QSize &mode, Orientation orientation, Reflection reflection)
+{
+  const int w = mode.width();
+  const int h = mode.height();
+  QTransform R;
+  switch (orientation)
+  {
+    case Orientation::Normal:
+      break;
+    case Orientation::Left:
+      R.setMatrix(0, -1, h, 1, 0, 0, 0, 0, 1);
+      break;
+    case Orientation::Inverted:
+      R.setMatrix(-1, 0, w, 0, -1, h, 0, 0, 1);
+      break;
+    case Orientation::Right:
+      R.setMatrix(0, 1, 0, -1, 0, w, 0, 0, 1);
+      break;
+  }
+  QSize framebuffer = mode;
+  if (orientation == Orientation::Left || orientation == Orientation::Right)
+    framebuffer.transpose();
+  const bool reflectX = reflection == Reflection::X || reflection == Reflection::XY;
+  const bool reflectY = reflection == Reflection::Y || reflection == Reflection::XY;
+  QTransform F;
+  F.setMatrix(reflectX ? -1 : 1, 0, reflectX ? framebuffer.width() : 0,
+              0, reflectY ? -1 : 1, reflectY ? framebuffer.height() : 0,
+              0, 0, 1);
+  QTransform M = F;
+  M *= R;
+  return M;
+}
+
+QString XRandrBackend::transformArgument(const XRandrMonitorConfig &config)
+{
+  const QTransform t = rotationTransform(config.resolution, stringToOrientation(config.orientation),
+                                         stringToReflection(config.reflection));
+  QStringList values;
+  for (qreal v : {t.m11(), t.m12(), t.m13(), t.m21(), t.m22(), t.m23(), t.m31(), t.m32(), t.m33()})
+    values << QString::number(v + 0.0, 'g', 10);
+  return values.join(',');
+}
+
 void XRandrBackend::parseXRandr()
 {
   if (m_parsed)
     return;
   m_parsed = true;
   m_monitorMap.clear();
+  TraceScope parseScope("XRandrBackend::parseXRandr");
   QProcess proc;
-  proc.start("xrandr", {"--query"});
-  if (!proc.waitForFinished(10000)) {
+  // --verbose adds the output properties to the regular query output.
+  if (!runTracedProcess(proc, "xrandr --query --verbose", "xrandr", {"--query", "--verbose"})) {
     qWarning() << "xrandr query timed out or failed.";
     return;
   }
-  QByteArray output = proc.readAllStandardOutput();
+  parseQueryOutput(proc.readAllStandardOutput());
+}
+
+void XRandrBackend::parseQueryOutput(const QByteArray &output)
+{
+  m_parsed = true;
+  m_monitorMap = parseMonitors(output);
+  m_screen = parseScreen(output);
+}
+
+void XRandrBackend::invalidate()
+{
+  m_parsed = false;
+  m_monitorMap.clear();
+  m_screen = XRandrScreenInfo();
+}
+
+XRandrScreenInfo XRandrBackend::parseScreen(const QByteArray &output)
+{
+  XRandrScreenInfo info;
+  static const QRegularExpression reScreen(
+      R"(^Screen \d+: minimum (\d+) x (\d+), current (\d+) x (\d+), maximum (\d+) x (\d+))");
+  QRegularExpressionMatch m = reScreen.match(QString::fromLatin1(output.left(output.indexOf('\n'))));
+  if (m.hasMatch())
+  {
+    info.minimum = QSize(m.captured(1).toInt(), m.captured(2).toInt());
+    info.current = QSize(m.captured(3).toInt(), m.captured(4).toInt());
+    info.maximum = QSize(m.captured(5).toInt(), m.captured(6).toInt());
+  }
+  return info;
+}
+
+XRandrTimingRange XRandrBackend::parseEdidRange(const QByteArray &edid)
+{
+  XRandrTimingRange range;
+  if (edid.size() < 128)
+    return range;
+  const auto byte = [&edid](int offset) { return int(quint8(edid.at(offset))); };
+  // Four 18 byte descriptors in the base block.
+  for (int offset = 54; offset <= 108; offset += 18)
+  {
+    if (byte(offset) != 0 || byte(offset + 1) != 0 || byte(offset + 2) != 0 || byte(offset + 3) != 0xFD)
+      continue;
+    // EDID 1.4 adds 255 to a rate when its offset flag is set.
+    const int flags = byte(offset + 4);
+    range.minVerticalHz = byte(offset + 5) + ((flags & 0x03) == 0x03 ? 255 : 0);
+    range.maxVerticalHz = byte(offset + 6) + ((flags & 0x02) ? 255 : 0);
+    range.minHorizontalKHz = byte(offset + 7) + ((flags & 0x0C) == 0x0C ? 255 : 0);
+    range.maxHorizontalKHz = byte(offset + 8) + ((flags & 0x08) ? 255 : 0);
+    range.maxPixelClockMHz = byte(offset + 9) * 10;
+    range.valid = range.maxVerticalHz > 0 && range.maxHorizontalKHz > 0;
+    break;
+  }
+  return range;
+}
+
+QHash<QString, XRandrMonitorInfo> XRandrBackend::parseMonitors(const QByteArray &output)
+{
+  QHash<QString, XRandrMonitorInfo> monitors;
+  TraceScope regexScope("parse xrandr output", "parse");
   QList<QByteArray> lines = output.split('\n');
   QRegularExpression reMon(
       R"(^(?<name>\S+)\s+(?<status>connected|disconnected)(?:\s+(?<primary>primary))?\s*(?<restLine>.*)$)");
+  // The verbose output puts the mode id, e.g. "(0x46)", before the rotation.
   QRegularExpression reLineConnected(
-      R"(.*?(?<width>\d+)x(?<height>\d+)\+(?<x>\d+)\+(?<y>\d+)(?:\s+(?<orient>normal|left|inverted|right))?\s*\((?<dummy>[^)]+)\).*)");
+      R"(.*?(?<width>\d+)x(?<height>\d+)\+(?<x>\d+)\+(?<y>\d+)(?:\s+\(0x[0-9a-f]+\))?(?:\s+(?<orient>normal|left|inverted|right))?(?:\s+(?<reflect>X axis|Y axis|X and Y axis))?\s*\((?<dummy>[^)]+)\).*)");
+  // Rotations and reflections the CRTC supports, e.g. "(normal left inverted right x axis y axis)".
+  QRegularExpression reRotations(R"(\((?<rotations>(?:normal|left|inverted|right|x axis|y axis| )+)\))");
   QRegularExpression reAnyRes(R"(^\s*(?<w>\d+)x(?<h>\d+)\s+\S+\s*(?<flags>.*))");
+  // Verbose mode lines, e.g. "1920x1080_60.00 (0x1c9) 173.000MHz -HSync +VSync *current",
+  // followed by "h: width 1920 start 2048 end 2248 total 2576 ..." and the same for v.
+  QRegularExpression reVerboseMode(R"(^(?<name>\S+)\s+\(0x(?<id>[0-9a-f]+)\)\s+(?<clock>[\d.]+)MHz(?<flags>.*)$)");
+  QRegularExpression reTiming(R"(^(?<axis>[hv]): (?:width|height)\s+(?<size>\d+) start\s+(?<start>\d+) end\s+(?<end>\d+) total\s+(?<total>\d+))");
+  QRegularExpression reProperty(R"(^\t(?<key>[^\t:][^:]*):\s*(?<value>.*)$)");
+  QRegularExpression reRange(R"(^\t\trange:\s*\((?<min>-?\d+),\s*(?<max>-?\d+)\))");
+  QRegularExpression reSupported(R"(^\t\tsupported:\s*(?<values>.*)$)");
   QString currentMonitor;
+  QString currentProperty;
+  QList<double> transformValues;
+  QHash<QString, QByteArray> edids;
+  bool readingEdid = false;
+  bool readingMode = false;
   bool inConnectedSection = false;
   for(const QByteArray &lineBA : lines)
   {
-    QString line = QString::fromLocal8Bit(lineBA).trimmed();
+    const QString rawLine = QString::fromLocal8Bit(lineBA);
+    QString line = rawLine.trimmed();
     if (line.isEmpty())
       continue;
+    if (rawLine.startsWith('\t'))
+    {
+      if (!inConnectedSection || !monitors.contains(currentMonitor))
+        continue;
+      XRandrMonitorInfo &info = monitors[currentMonitor];
+      QRegularExpressionMatch pm = reProperty.match(rawLine);
+      if (!pm.hasMatch() && readingEdid)
+      {
+        edids[currentMonitor] += QByteArray::fromHex(line.toLatin1());
+        continue;
+      }
+      readingEdid = false;
+      if (pm.hasMatch())
+      {
+        const QString key = pm.captured("key");
+        const QString value = pm.captured("value").trimmed();
+        if (key == "EDID")
+        {
+          readingEdid = true;
+          currentProperty.clear();
+          continue;
+        }
+        if (key == "CRTC")
+        {
+          info.crtc = value.toInt();
+          currentProperty.clear();
+          continue;
+        }
+        if (key == "CRTCs")
+        {
+          for (const QString &crtc : value.split(' ', Qt::SkipEmptyParts))
+            info.crtcs << crtc.toInt();
+          currentProperty.clear();
+          continue;
+        }
+        if (key == "Clones")
+        {
+          info.clones = value.split(' ', Qt::SkipEmptyParts);
+          currentProperty.clear();
+          continue;
+        }
+        if (key == "TILE")
+        {
+          // group flags columns rows column row width height
+          const QStringList fields = QString(value).replace(',', ' ').split(' ', Qt::SkipEmptyParts);
+          if (fields.size() == 8)
+          {
+            info.tile.group = fields.at(0).toInt();
+            info.tile.columns = fields.at(2).toInt();
+            info.tile.rows = fields.at(3).toInt();
+            info.tile.column = fields.at(4).toInt();
+            info.tile.row = fields.at(5).toInt();
+            info.tile.size = QSize(fields.at(6).toInt(), fields.at(7).toInt());
+          }
+          currentProperty.clear();
+          continue;
+        }
+      }
+      if (pm.hasMatch() && pm.captured("key") == "Transform")
+      {
+        // Three rows; only the first one carries the property name.
+        currentProperty.clear();
+        transformValues.clear();
+        for (const QString &value : pm.captured("value").split(' ', Qt::SkipEmptyParts))
+          transformValues << value.toDouble();
+        continue;
+      }
+      if (!pm.hasMatch() && (transformValues.size() == 3 || transformValues.size() == 6))
+      {
+        for (const QString &value : line.split(' ', Qt::SkipEmptyParts))
+          transformValues << value.toDouble();
+        if (transformValues.size() == 9)
+        {
+          info.transform.setMatrix(transformValues.at(0), transformValues.at(1), transformValues.at(2),
+                                   transformValues.at(3), transformValues.at(4), transformValues.at(5),
+                                   transformValues.at(6), transformValues.at(7), transformValues.at(8));
+        }
+        continue;
+      }
+      if (pm.hasMatch())
+      {
+        currentProperty = pm.captured("key");
+        if (tunableProperties().contains(currentProperty) || currentProperty == "vrr_capable")
+          info.properties[currentProperty].value = pm.captured("value").trimmed();
+        else
+          currentProperty.clear();
+        continue;
+      }
+      if (currentProperty.isEmpty())
+        continue;
+      XRandrOutputProperty &property = info.properties[currentProperty];
+      QRegularExpressionMatch rm = reRange.match(rawLine);
+      if (rm.hasMatch())
+      {
+        property.hasRange = true;
+        property.rangeMin = rm.captured("min").toInt();
+        property.rangeMax = rm.captured("max").toInt();
+        continue;
+      }
+      QRegularExpressionMatch sm = reSupported.match(rawLine);
+      if (sm.hasMatch())
+      {
+        for (const QString &value : sm.captured("values").split(','))
+        {
+          if (!value.trimmed().isEmpty())
+            property.supported << value.trimmed();
+        }
+      }
+      continue;
+    }
+    currentProperty.clear();
+    transformValues.clear();
+    readingEdid = false;
+    readingMode = false;
     QRegularExpressionMatch mm = reMon.match(line);
     if(mm.hasMatch())
     {
@@ -123,6 +980,18 @@ void XRandrBackend::parseXRandr()
       XRandrMonitorInfo info;
       info.connected = inConnectedSection;
       info.isPrimary = !maybePrimary.isEmpty();
+      QRegularExpressionMatch rotm = reRotations.match(restLine);
+      if (rotm.hasMatch())
+      {
+        const QString rotations = rotm.captured("rotations");
+        for (Orientation orient : {Orientation::Normal, Orientation::Left, Orientation::Inverted, Orientation::Right})
+        {
+          if (rotations.contains(orientationToString(orient)))
+            info.rotations << orient;
+        }
+        info.canReflectX = rotations.contains("x axis");
+        info.canReflectY = rotations.contains("y axis");
+      }
       if(inConnectedSection)
       {
         QRegularExpressionMatch mm2 = reLineConnected.match(restLine);
@@ -140,27 +1009,118 @@ void XRandrBackend::parseXRandr()
           info.position = QPoint(px, py);
           info.currentResolution = QSize(w, h);
           info.orientation = orient;
+          const QString reflect = mm2.captured("reflect");
+          if (reflect == "X and Y axis")
+            info.reflection = Reflection::XY;
+          else if (reflect == "X axis")
+            info.reflection = Reflection::X;
+          else if (reflect == "Y axis")
+            info.reflection = Reflection::Y;
         }
       }
-      m_monitorMap.insert(currentMonitor, info);
+      monitors.insert(currentMonitor, info);
       continue;
     }
     if(inConnectedSection && !currentMonitor.isEmpty())
     {
-      if (!m_monitorMap.contains(currentMonitor))
+      if (!monitors.contains(currentMonitor))
         continue;
-      XRandrMonitorInfo info = m_monitorMap.value(currentMonitor);
+      QRegularExpressionMatch vm = reVerboseMode.match(line);
+      if (vm.hasMatch())
+      {
+        XRandrMode mode;
+        mode.id = vm.captured("id").toUInt(nullptr, 16);
+        mode.current = vm.captured("flags").contains("*current");
+        mode.preferred = vm.captured("flags").contains("+preferred");
+        mode.modeline.name = vm.captured("name");
+        mode.modeline.clockMHz = vm.captured("clock").toDouble();
+        mode.modeline.hSyncPositive = vm.captured("flags").contains("+HSync");
+        mode.modeline.vSyncPositive = vm.captured("flags").contains("+VSync");
+        monitors[currentMonitor].modes << mode;
+        readingMode = true;
+      }
+      else if (readingMode)
+      {
+        QRegularExpressionMatch tm = reTiming.match(line);
+        if (tm.hasMatch())
+        {
+          Modeline &mode = monitors[currentMonitor].modes.last().modeline;
+          if (tm.captured("axis") == "h")
+          {
+            mode.hDisplay = tm.captured("size").toInt();
+            mode.hSyncStart = tm.captured("start").toInt();
+            mode.hSyncEnd = tm.captured("end").toInt();
+            mode.hTotal = tm.captured("total").toInt();
+          }
+          else
+          {
+            mode.vDisplay = tm.captured("size").toInt();
+            mode.vSyncStart = tm.captured("start").toInt();
+            mode.vSyncEnd = tm.captured("end").toInt();
+            mode.vTotal = tm.captured("total").toInt();
+          }
+        }
+        continue;
+      }
+      XRandrMonitorInfo info = monitors.value(currentMonitor);
       QRegularExpressionMatch rm = reAnyRes.match(line);
       if(rm.hasMatch())
       {
         int w = rm.captured("w").toInt();
         int h = rm.captured("h").toInt();
-        info.allResolutions << QSize(w, h);
+        // The verbose output lists every refresh rate as a separate mode.
+        if (!info.allResolutions.contains(QSize(w, h)))
+          info.allResolutions << QSize(w, h);
         QString flags = rm.captured("flags");
         if (flags.contains('*'))
           info.currentResolution = QSize(w, h);
-        m_monitorMap.insert(currentMonitor, info);
+        monitors.insert(currentMonitor, info);
+      }
+    }
+  }
+
+  for (XRandrMonitorInfo &info : monitors)
+  {
+    for (const XRandrMode &mode : std::as_const(info.modes))
+    {
+      if (mode.current)
+        info.currentMode = mode.modeline;
+      if (mode.preferred)
+        info.preferredMode = mode.modeline;
+    }
+  }
+
+  for (auto it = edids.constBegin(); it != edids.constEnd(); ++it)
+  {
+    auto monitor = monitors.find(it.key());
+    if (monitor != monitors.end())
+    {
+      monitor->timingRange = parseEdidRange(it.value());
+      monitor->edidFingerprint = edidFingerprint(it.value());
+    }
+  }
+
+  // Recognize the transforms dpset sets for the rotations the CRTC cannot do.
+  for (XRandrMonitorInfo &info : monitors)
+  {
+    if (!info.connected || info.transform.isIdentity()
+    ||  info.orientation != Orientation::Normal || info.reflection != Reflection::None)
+    {
+      continue;
+    }
+    for (Orientation orient : {Orientation::Normal, Orientation::Left, Orientation::Inverted, Orientation::Right})
+    {
+      for (Reflection reflect : {Reflection::None, Reflection::X, Reflection::Y, Reflection::XY})
+      {
+        if (!info.emulatedRotation
+        &&  sameMatrix(rotationTransform(info.currentResolution, orient, reflect), info.transform))
+        {
+          info.orientation = orient;
+          info.reflection = reflect;
+          info.emulatedRotation = true;
+        }
       }
     }
   }
+  return monitors;
 }
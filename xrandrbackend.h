@@ -1,16 +1,102 @@
 #pragma once
 
 #include <QtCore>
+#include <QTransform>
+#include "modeline.h"
 #include "orientation.h"
 
+struct XRandrOutputProperty
+{
+  QString value;
+  // Allowed values, either enumerated or as an integer range.
+  QStringList supported;
+  bool hasRange = false;
+  int rangeMin = 0;
+  int rangeMax = 0;
+};
+
+// Monitor range limits from the EDID display descriptor 0xFD.
+struct XRandrTimingRange
+{
+  bool valid = false;
+  int minVerticalHz = 0;
+  int maxVerticalHz = 0;
+  int minHorizontalKHz = 0;
+  int maxHorizontalKHz = 0;
+  // 0 when the monitor does not state a limit.
+  int maxPixelClockMHz = 0;
+};
+
+// The "Screen 0:" line, i.e. what XRRGetScreenSizeRange() returns.
+struct XRandrScreenInfo
+{
+  QSize minimum;
+  QSize current;
+  QSize maximum;
+};
+
+// The TILE property of an output that drives one tile of a larger display,
+// e.g. one half of a 5K panel connected as two DisplayPort MST streams.
+struct XRandrTile
+{
+  // Outputs of one display share the group; -1 when the output is no tile.
+  int group = -1;
+  int columns = 1;
+  int rows = 1;
+  int column = 0;
+  int row = 0;
+  // Native size of this tile.
+  QSize size;
+
+  bool isValid() const { return group >= 0 && size.isValid(); }
+};
+
+// One RandR mode an output lists. The same XID in the lists of two outputs
+// is one mode object, which a shared CRTC can drive both outputs with.
+struct XRandrMode
+{
+  quint32 id = 0;
+  Modeline modeline;
+  bool current = false;
+  bool preferred = false;
+
+  QSize size() const { return QSize(modeline.hDisplay, modeline.vDisplay); }
+};
+
 struct XRandrMonitorInfo
 {
   bool connected = false;
   bool isPrimary = false;
   QPoint position;
   QSize currentResolution;
-  Orientation orientation;
+  Orientation orientation = Orientation::Normal;
+  Reflection reflection = Reflection::None;
+  // Set when the orientation is not done by the CRTC but by a --transform,
+  // see XRandrBackend::rotationTransform().
+  bool emulatedRotation = false;
+  // What the CRTC can do in hardware; empty when xrandr does not report it.
+  QList<Orientation> rotations;
+  bool canReflectX = false;
+  bool canReflectY = false;
+  QTransform transform;
+  // CRTC in use (-1 when off), the CRTCs that can drive the output and the
+  // outputs that can share a CRTC with it.
+  int crtc = -1;
+  QList<int> crtcs;
+  QStringList clones;
+  XRandrTimingRange timingRange;
+  // Hash of the whole EDID, see XRandrBackend::edidFingerprint(); empty
+  // when the monitor reports none.
+  QString edidFingerprint;
+  // The mode in use with its full timings; empty name when off.
+  Modeline currentMode;
+  // The mode the monitor asks for, i.e. its native timing.
+  Modeline preferredMode;
+  XRandrTile tile;
+  // Every mode of the verbose output, with its XID and timings.
+  QList<XRandrMode> modes;
   QList<QSize> allResolutions;
+  QMap<QString, XRandrOutputProperty> properties;
 };
 
 struct XRandrMonitorConfig
@@ -19,22 +105,99 @@ struct XRandrMonitorConfig
   QSize resolution;
   QPoint position;
   QString orientation;
-  bool isPrimary;
+  QString reflection = "normal";
+  // Rotate and reflect with a transform instead of the CRTC.
+  bool emulatedRotation = false;
+  bool isPrimary = false;
+  // The mode is not one the monitor advertises and has to be created first.
+  bool isCustom = false;
+  // RandR output properties to set, e.g. "max bpc" -> "10".
+  QMap<QString, QString> properties;
+  // Output whose picture this one shows, see XRandrBackend::planClones().
+  QString cloneOf;
+  // CRTC the output shares with its clones or its source; -1 lets xrandr pick one.
+  int crtc = -1;
+  // Area of the source to scale onto the mode of a clone whose mode differs.
+  QSize scaleFrom;
+  // Refresh rate to select among the modes of the resolution; 0 for any.
+  double rate = 0.0;
+  // Exact RandR mode by XID, e.g. the one a clone shares with its source;
+  // 0 selects the mode by name and rate. XIDs belong to the running server,
+  // so buildScript() selects this mode by name and rate as well.
+  quint32 modeId = 0;
+  // RandR 1.5 monitor the output is a tile of. All tiles of a monitor are
+  // always configured together, see changedConfigs().
+  QString monitor;
 };
 
 class XRandrBackend
 {
 public:
   static XRandrBackend& instance();
+  // Output properties dpset lets the user change.
+  static const QStringList& tunableProperties();
+  // Maps output pixels to framebuffer pixels like the CRTC would for the
+  // orientation and reflection; the reflection is applied after the rotation.
+  static QTransform rotationTransform(const QSize &mode, Orientation orientation, Reflection reflection);
+  // Decides how each clone shows its source: on the CRTC of the source when
+  // both outputs list one mode XID of the size and RandR allows them to be
+  // cloned, so the framebuffer is scanned out once; otherwise on a CRTC of
+  // its own, with --same-as, or with --scale-from when its size differs.
+  static void planClones(QList<XRandrMonitorConfig> &configs, const QHash<QString, XRandrMonitorInfo> &monitors);
+  // Memory read per second to scan out an area of the framebuffer (32 bpp).
+  static double scanoutBytesPerSecond(const QSize &area, double refreshRate);
 
   const QHash<QString, XRandrMonitorInfo>& monitors();
+  const XRandrScreenInfo& screen();
   QStringList connectedMonitorNames();
 
+  QList<QStringList> modeCommands(const QList<XRandrMonitorConfig>& configs) const;
+  QStringList outputArguments(const QList<XRandrMonitorConfig>& configs) const;
+  // Expects the output of "xrandr --current --verbose" in $randr_verbose,
+  // see buildApplyScript(); so does buildEdidCheck().
   QString buildScript(const QList<XRandrMonitorConfig>& configs) const;
+  QString buildXorgConfig(const QList<XRandrMonitorConfig>& configs) const;
+  // Reads back a configuration written by buildXorgConfig() and describes every
+  // difference between the geometry it produces and the given configs.
+  QStringList validateXorgConfig(const QString &config, const QList<XRandrMonitorConfig>& configs) const;
+  bool matchesCurrentState(const QList<XRandrMonitorConfig>& configs) const;
+  // The configs whose geometry, primary flag or properties differ from the
+  // last state read from the X server, with all tiles of a monitor when one
+  // of them differs.
+  QList<XRandrMonitorConfig> changedConfigs(const QList<XRandrMonitorConfig>& configs) const;
+  void parseQueryOutput(const QByteArray &output);
+  // Forgets the cached state, e.g. when it could not be read back after an
+  // apply. changedConfigs() then reports every config and the next access
+  // to monitors() or screen() queries the X server again.
+  void invalidate();
+  // Parses the output of "xrandr --query --verbose", or any part of it that
+  // consists of complete output blocks.
+  static QHash<QString, XRandrMonitorInfo> parseMonitors(const QByteArray &output);
+  static XRandrScreenInfo parseScreen(const QByteArray &output);
+  static XRandrTimingRange parseEdidRange(const QByteArray &edid);
+  // Lowercase hex SHA-256 over the whole EDID as lowercase hex text, the way
+  // "xrandr --verbose" prints it with the whitespace and line breaks removed.
+  // The bytes are hashed as a whole, so the fingerprint changes with any
+  // byte, not only with the model and serial. For a manifest:
+  //   printf '%s' 00ffffffffffff00... | sha256sum
+  static QString edidFingerprint(const QByteArray &edid);
+  // Bash that stops the script with exit code 3 unless every output shows
+  // the monitor with the given fingerprint, so a script generated for one
+  // console is not applied to another. DPSET_SKIP_EDID_CHECK=1 skips it.
+  static QString buildEdidCheck(const QMap<QString, QString> &fingerprints);
 
 private:
   bool m_parsed = false;
   QHash<QString, XRandrMonitorInfo> m_monitorMap;
+  XRandrScreenInfo m_screen;
 
   void parseXRandr();
+  static QString modeName(const XRandrMonitorConfig &config);
+  static QString transformArgument(const XRandrMonitorConfig &config);
+  // Lines the generated script expects in its summary of the current state.
+  static QStringList fingerprint(const XRandrMonitorConfig &config);
+  // Comment stating how a clone is driven and what scanout bandwidth that takes.
+  QString cloneComment(const XRandrMonitorConfig &config) const;
+  // --setmonitor for every monitor whose tiles are all in configs.
+  static QStringList monitorArguments(const QList<XRandrMonitorConfig> &configs);
 };